@@ -0,0 +1,296 @@
+#include "base.h"
+#include "osc_out.h"
+#include <arpa/inet.h>
+#include <getopt.h>
+
+#define SOKOL_IMPL
+#include "sokol_time.h"
+#undef SOKOL_IMPL
+
+// Times encoding the OSC messages Orca sends, the way it was done before
+// Oosc_dev kept templates of them (packing the address and typetag for every
+// message), against oosc_dev_encode_int32s(). The mix is what '=' sends for
+// each glyph, with 1 to 5 ints, plus the 3 int messages of --osc-midi-bidule.
+// Both encoders are checked to give the same bytes before anything is timed.
+// Prints one JSON object per line:
+//
+//   encoder           "uncached" or "cached"
+//   messages, rounds  Timed messages per round, and how many rounds
+//   msgs_per_sec      From the median round
+//   ns_per_msg        Same
+//   spread            (slowest round - fastest round) / median round
+//   speedup           Only for "cached": its msgs_per_sec over "uncached"
+//
+// Nothing gets sent. The device is only created for its templates.
+
+static ORCA_NOINLINE void usage(void)
+{ // clang-format off
+fprintf(stderr,
+"Usage: bench_osc [options]\n\n"
+"Options:\n"
+"    -n <number>   Number of messages to encode per round.\n"
+"                  Default: 1000000\n"
+"    -r <number>   Number of timed rounds per encoder.\n"
+"                  Default: 5\n"
+"    -h or --help  Print this message and exit.\n"
+);} // clang-format on
+
+#ifdef BENCH_WRAP_ALLOC
+// The bench Makefile wraps these for every benchmark. Nothing here counts
+// them.
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void *__wrap_malloc(size_t size)
+{
+    return __real_malloc(size);
+}
+void *__wrap_calloc(size_t count, size_t size)
+{
+    return __real_calloc(count, size);
+}
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    return __real_realloc(ptr, size);
+}
+#endif
+
+// The encoder as it was in osc_out.c, for comparison.
+static bool old_write_strn(
+    char *restrict buffer,
+    Usz buffer_size,
+    Usz *buffer_pos,
+    char const *restrict in_str,
+    Usz in_str_len)
+{
+    // no overflow check, should be fine
+    Usz in_plus_null = in_str_len + 1;
+    Usz null_pad = (4 - in_plus_null % 4) % 4;
+    Usz needed = in_plus_null + null_pad;
+    Usz cur_pos = *buffer_pos;
+    if (cur_pos + needed >= buffer_size)
+        return false;
+    for (Usz i = 0; i < in_str_len; ++i) {
+        buffer[cur_pos + i] = in_str[i];
+    }
+    buffer[cur_pos + in_str_len] = 0;
+    cur_pos += in_plus_null;
+    for (Usz i = 0; i < null_pad; ++i) {
+        buffer[cur_pos + i] = 0;
+    }
+    *buffer_pos = cur_pos + null_pad;
+    return true;
+}
+
+static ORCA_NOINLINE Usz old_encode_int32s(
+    char *buffer,
+    Usz buffer_size,
+    char const *osc_address,
+    I32 const *vals,
+    Usz count)
+{
+    Usz buf_pos = 0;
+    if (!old_write_strn(buffer, buffer_size, &buf_pos, osc_address, strlen(osc_address)))
+        return 0;
+    Usz typetag_str_size = 1 + count + 1; // comma, 'i'... , null
+    Usz typetag_str_null_pad = (4 - typetag_str_size % 4) % 4;
+    if (buf_pos + typetag_str_size + typetag_str_null_pad > buffer_size)
+        return 0;
+    buffer[buf_pos] = ',';
+    ++buf_pos;
+    for (Usz i = 0; i < count; ++i) {
+        buffer[buf_pos + i] = 'i';
+    }
+    buffer[buf_pos + count] = 0;
+    buf_pos += count + 1;
+    for (Usz i = 0; i < typetag_str_null_pad; ++i) {
+        buffer[buf_pos + i] = 0;
+    }
+    buf_pos += typetag_str_null_pad;
+    Usz ints_size = count * sizeof(I32);
+    if (buf_pos + ints_size > buffer_size)
+        return 0;
+    for (Usz i = 0; i < count; ++i) {
+        union {
+            I32 i;
+            U32 u;
+        } pun;
+        pun.i = vals[i];
+        U32 u_ne = htonl(pun.u);
+        memcpy(buffer + buf_pos, &u_ne, sizeof(u_ne));
+        buf_pos += sizeof(u_ne);
+    }
+    return buf_pos;
+}
+
+enum
+{
+    Mix_glyphs = 26,
+    Mix_count = Mix_glyphs + 1, // Plus the Bidule message
+    Msg_buffer_size = 2048 - 20, // What oosc_send_int32s() leaves after the bundle header
+};
+
+typedef struct {
+    char address[24];
+    I32 vals[5];
+    Usz count;
+} Mix_msg;
+
+static void make_mix(Mix_msg *mix)
+{
+    for (Usz i = 0; i < Mix_glyphs; ++i) {
+        Mix_msg *m = mix + i;
+        m->address[0] = '/';
+        m->address[1] = (char)('a' + i);
+        m->address[2] = '\0';
+        m->count = 1 + i % 5;
+        for (Usz j = 0; j < m->count; ++j)
+            m->vals[j] = (I32)((i * 7 + j * 13) % 36);
+    }
+    Mix_msg *m = mix + Mix_glyphs;
+    strcpy(m->address, "/OSC_MIDI_0/MIDI");
+    m->vals[0] = 0x90;
+    m->vals[1] = 60;
+    m->vals[2] = 100;
+    m->count = 3;
+}
+
+static int compare_u64(void const *a, void const *b)
+{
+    U64 x = *(U64 const *)a, y = *(U64 const *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Returns the median round's time, and prints its line.
+static double bench_encoder(
+    Oosc_dev *dev, // NULL for the old encoder
+    Mix_msg *mix,
+    Usz messages,
+    Usz rounds,
+    U64 *round_ns,
+    double uncached_median)
+{
+    char buffer[Msg_buffer_size];
+    Usz checksum = 0;
+    for (Usz round = 0; round <= rounds; ++round) {
+        U64 start = stm_now();
+        for (Usz i = 0, k = 0; i < messages; ++i) {
+            Mix_msg *m = mix + k;
+            // Different ints each time, like a playing patch would send
+            m->vals[0] = (I32)(i & 0x7F);
+            Usz size;
+            if (dev)
+                size = oosc_dev_encode_int32s(
+                    dev, buffer, sizeof buffer, m->address, m->vals, m->count);
+            else
+                size = old_encode_int32s(buffer, sizeof buffer, m->address, m->vals, m->count);
+            checksum += size + (U8)buffer[size - 1];
+            if (++k == Mix_count)
+                k = 0;
+        }
+        U64 ns = (U64)stm_ns(stm_since(start));
+        if (round > 0) // The first one is a warmup
+            round_ns[round - 1] = ns;
+    }
+    qsort(round_ns, rounds, sizeof(U64), compare_u64);
+    double median = (double)round_ns[rounds / 2];
+    if (median < 1.0)
+        median = 1.0;
+    printf(
+        "{\"encoder\":\"%s\",\"messages\":%zu,\"rounds\":%zu,\"msgs_per_sec\":%.1f,"
+        "\"ns_per_msg\":%.2f,\"spread\":%.4f",
+        dev ? "cached" : "uncached",
+        messages,
+        rounds,
+        (double)messages * 1e9 / median,
+        median / (double)messages,
+        (double)(round_ns[rounds - 1] - round_ns[0]) / median);
+    if (dev)
+        printf(",\"speedup\":%.3f", uncached_median / median);
+    printf("}\n");
+    fflush(stdout);
+    // So the loops can't be thrown out
+    if (checksum == 1)
+        fprintf(stderr, "\n");
+    return median;
+}
+
+static bool check_same_bytes(Oosc_dev *dev, Mix_msg const *mix)
+{
+    char a[Msg_buffer_size], b[Msg_buffer_size];
+    // Twice, so the second time goes through the templates
+    for (Usz pass = 0; pass < 2; ++pass) {
+        for (Usz i = 0; i < Mix_count; ++i) {
+            Mix_msg const *m = mix + i;
+            Usz a_size = old_encode_int32s(a, sizeof a, m->address, m->vals, m->count);
+            Usz b_size = oosc_dev_encode_int32s(dev, b, sizeof b, m->address, m->vals, m->count);
+            if (a_size == 0 || a_size != b_size || memcmp(a, b, a_size) != 0) {
+                fprintf(stderr, "Encoders differ for %s.\n", m->address);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    static struct option bench_options[] = { { "help", no_argument, 0, 'h' }, { NULL, 0, NULL, 0 } };
+
+    int messages = 1000000;
+    int rounds = 5;
+
+    for (;;) {
+        int c = getopt_long(argc, argv, "n:r:h", bench_options, NULL);
+        if (c == -1)
+            break;
+        switch (c) {
+            case 'n':
+            case 'r': {
+                int n = atoi(optarg);
+                if (n < 1) {
+                    fprintf(stderr, "Bad -%c argument %s.\nMust be a positive integer.\n", c, optarg);
+                    return 1;
+                }
+                *(c == 'n' ? &messages : &rounds) = n;
+                break;
+            }
+            case 'h':
+                usage();
+                return 0;
+            case '?':
+                usage();
+                return 1;
+        }
+    }
+    if (optind != argc) {
+        fprintf(stderr, "Unexpected argument %s.\n", argv[optind]);
+        usage();
+        return 1;
+    }
+#ifndef NDEBUG
+    fprintf(stderr, "Warning: this is a debug build, build with DEBUG=0 for useful numbers.\n");
+#endif
+
+    Oosc_dev *dev;
+    Oosc_udp_create_error err = oosc_dev_create_udp(&dev, NULL, "49162");
+    if (err) {
+        fprintf(stderr, "Couldn't create the OSC device.\n");
+        return 1;
+    }
+    Mix_msg mix[Mix_count];
+    make_mix(mix);
+    int result = 0;
+    if (!check_same_bytes(dev, mix)) {
+        result = 1;
+        goto done;
+    }
+    stm_setup();
+    U64 *round_ns = malloc((Usz)rounds * sizeof(U64));
+    double uncached = bench_encoder(NULL, mix, (Usz)messages, (Usz)rounds, round_ns, 0.0);
+    bench_encoder(dev, mix, (Usz)messages, (Usz)rounds, round_ns, uncached);
+    free(round_ns);
+done:
+    oosc_dev_destroy(dev);
+    return result;
+}
@@ -0,0 +1,309 @@
+#include "base.h"
+#include "field.h"
+#include "gbuffer.h"
+#include "sim.h"
+#include "vmio.h"
+#include <getopt.h>
+
+#define SOKOL_IMPL
+#include "sokol_time.h"
+#undef SOKOL_IMPL
+
+// Runs each patch it's given headless through orca_run(), as loaded and tiled
+// into a bigger grid, and prints one JSON object per line for each:
+//
+//   patch, tiles      The file, and how many copies of it across and down
+//   height, width     Of the grid that was run
+//   ticks, rounds     Timed ticks per round, and how many rounds
+//   ticks_per_sec     From the median round
+//   ns_per_live_cell  Median round time over the non-'.' cells the ticks
+//                     started with, summed over the round
+//   spread            (slowest round - fastest round) / median round
+//   events_per_tick   Output events
+//   allocs_per_tick   Calls to malloc, calloc and realloc during the timed
+//                     ticks, or null if the build can't count them
+//   operators         Only in builds with PROFILE_ENABLED=1: for each glyph
+//                     that ran, its calls, early_exits and time per tick
+//                     (see orca_profile in sim.h)
+//
+// Each round starts over from the loaded grid with tick number 0, so every
+// round does exactly the same work, and an untimed round goes first to warm
+// up caches and buffers. Only the ticks themselves are timed.
+
+static ORCA_NOINLINE void usage(void)
+{ // clang-format off
+fprintf(stderr,
+"Usage: bench_tick [options] infile...\n\n"
+"Options:\n"
+"    -t <number>   Number of timesteps to run per round.\n"
+"                  Default: 1000\n"
+"    -r <number>   Number of timed rounds per grid.\n"
+"                  Default: 5\n"
+"    -s <number>   Also run each patch tiled this many times across and\n"
+"                  down, or 1 to only run it as is.\n"
+"                  Default: 8\n"
+"    -h or --help  Print this message and exit.\n"
+);} // clang-format on
+
+#ifdef BENCH_WRAP_ALLOC
+static Usz alloc_count;
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void *__wrap_malloc(size_t size)
+{
+    ++alloc_count;
+    return __real_malloc(size);
+}
+void *__wrap_calloc(size_t count, size_t size)
+{
+    ++alloc_count;
+    return __real_calloc(count, size);
+}
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    ++alloc_count;
+    return __real_realloc(ptr, size);
+}
+#endif
+
+static void tile_field(Field *src, Usz tiles, Field *dest)
+{
+    field_resize_raw(dest, src->height * tiles, src->width * tiles);
+    for (Usz ty = 0; ty < tiles; ++ty) {
+        for (Usz tx = 0; tx < tiles; ++tx) {
+            gbuffer_copy_subrect(
+                src->buffer,
+                dest->buffer,
+                src->height,
+                src->width,
+                dest->height,
+                dest->width,
+                0,
+                0,
+                ty * src->height,
+                tx * src->width,
+                src->height,
+                src->width);
+        }
+    }
+}
+
+static Usz count_live_cells(Field const *field)
+{
+    Usz count = 0;
+    for (Usz i = 0, n = (Usz)field->height * field->width; i < n; ++i)
+        count += field->buffer[i] != '.';
+    return count;
+}
+
+static void json_fput_string(char const *s, FILE *stream)
+{
+    fputc('"', stream);
+    for (; *s; ++s) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\')
+            fprintf(stream, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(stream, "\\u%04x", c);
+        else
+            fputc(c, stream);
+    }
+    fputc('"', stream);
+}
+
+static int compare_u64(void const *a, void const *b)
+{
+    U64 x = *(U64 const *)a, y = *(U64 const *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void bench_field(
+    char const *path,
+    Usz tiles,
+    Field *loaded,
+    Usz ticks,
+    Usz rounds,
+    U64 *round_ns)
+{
+    Field field;
+    field_init(&field);
+    MarkBuf mbuf_r;
+    markbuf_init(&mbuf_r);
+    markbuf_ensure_size(&mbuf_r, loaded->height, loaded->width);
+    OccBuf obuf_r;
+    occbuf_init(&obuf_r);
+    Oprog prog;
+    oprog_init(&prog);
+    Oevent_list oevent_list;
+    oevent_list_init(&oevent_list);
+    Usz live_cells = 0, events = 0, allocs = 0;
+    for (Usz round = 0; round <= rounds; ++round) {
+        field_copy(loaded, &field);
+        occbuf_invalidate(&obuf_r);
+        oprog_invalidate(&prog);
+        Occword *obuf = occbuf_sync(&obuf_r, &field);
+        Usz round_live_cells = 0, round_events = 0;
+        U64 ns = 0;
+#ifdef BENCH_WRAP_ALLOC
+        alloc_count = 0;
+#endif
+        for (Usz i = 0; i < ticks; ++i) {
+            round_live_cells += count_live_cells(&field);
+            U64 start = stm_now();
+            markbuf_clear(&mbuf_r);
+            oevent_list_clear(&oevent_list);
+            orca_run(
+                field.buffer,
+                mbuf_r.buffer,
+                mbuf_r.dirty,
+                obuf,
+                &prog,
+                field.height,
+                field.width,
+                i,
+                &oevent_list,
+                0,
+                NULL);
+            ns += (U64)stm_ns(stm_since(start));
+            round_events += oevent_list.count;
+        }
+        if (round == 0) { // Warmup
+#ifdef FEAT_PROFILE
+            orca_profile_reset();
+#endif
+            continue;
+        }
+        round_ns[round - 1] = ns;
+        live_cells = round_live_cells;
+        events = round_events;
+#ifdef BENCH_WRAP_ALLOC
+        allocs += alloc_count;
+#endif
+    }
+    field_deinit(&field);
+    markbuf_deinit(&mbuf_r);
+    occbuf_deinit(&obuf_r);
+    oprog_deinit(&prog);
+    oevent_list_deinit(&oevent_list);
+
+    qsort(round_ns, rounds, sizeof(U64), compare_u64);
+    double median = (double)round_ns[rounds / 2];
+    if (median < 1.0)
+        median = 1.0;
+    printf("{\"patch\":");
+    json_fput_string(path, stdout);
+    printf(
+        ",\"tiles\":%zu,\"height\":%zu,\"width\":%zu,\"ticks\":%zu,\"rounds\":%zu,"
+        "\"ticks_per_sec\":%.1f,\"ns_per_live_cell\":%.3f,\"spread\":%.4f,"
+        "\"events_per_tick\":%.3f,",
+        tiles,
+        (Usz)loaded->height,
+        (Usz)loaded->width,
+        ticks,
+        rounds,
+        (double)ticks * 1e9 / median,
+        live_cells ? median / (double)live_cells : 0.0,
+        (double)(round_ns[rounds - 1] - round_ns[0]) / median,
+        (double)events / (double)ticks);
+#ifdef BENCH_WRAP_ALLOC
+    printf("\"allocs_per_tick\":%.4f", (double)allocs / (double)(ticks * rounds));
+#else
+    (void)allocs;
+    printf("\"allocs_per_tick\":null");
+#endif
+#ifdef FEAT_PROFILE
+    Oprof const *prof = orca_profile();
+    Glyph glyphs[ORCA_ARRAY_COUNTOF(prof->glyphs)];
+    Usz glyph_count = orca_profile_sorted(prof, glyphs);
+    double total_ticks = (double)(ticks * rounds);
+    printf(",\"operators\":{");
+    for (Usz i = 0; i < glyph_count; ++i) {
+        Oprof_glyph const *pg = prof->glyphs + (U8)glyphs[i];
+        char name[2] = { glyphs[i], '\0' };
+        if (i > 0)
+            putchar(',');
+        json_fput_string(name, stdout);
+        printf(
+            ":{\"calls\":%.3f,\"early_exits\":%.3f,\"time\":%.1f}",
+            (double)pg->calls / total_ticks,
+            (double)pg->early_exits / total_ticks,
+            (double)pg->time / total_ticks);
+    }
+    putchar('}');
+#endif
+    printf("}\n");
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    static struct option bench_options[] = { { "help", no_argument, 0, 'h' }, { NULL, 0, NULL, 0 } };
+
+    int ticks = 1000;
+    int rounds = 5;
+    int tiles = 8;
+
+    for (;;) {
+        int c = getopt_long(argc, argv, "t:r:s:h", bench_options, NULL);
+        if (c == -1)
+            break;
+        switch (c) {
+            case 't':
+            case 'r':
+            case 's': {
+                int n = atoi(optarg);
+                if (n < 1) {
+                    fprintf(stderr, "Bad -%c argument %s.\nMust be a positive integer.\n", c, optarg);
+                    return 1;
+                }
+                *(c == 't' ? &ticks : c == 'r' ? &rounds : &tiles) = n;
+                break;
+            }
+            case 'h':
+                usage();
+                return 0;
+            case '?':
+                usage();
+                return 1;
+        }
+    }
+
+    if (optind == argc) {
+        fprintf(stderr, "No input files.\n");
+        usage();
+        return 1;
+    }
+#ifndef NDEBUG
+    fprintf(stderr, "Warning: this is a debug build, build with DEBUG=0 for useful numbers.\n");
+#endif
+
+    stm_setup();
+    U64 *round_ns = malloc((Usz)rounds * sizeof(U64));
+    Field loaded, tiled;
+    field_init(&loaded);
+    field_init(&tiled);
+    int result = 0;
+    for (int i = optind; i < argc; ++i) {
+        Field_load_error fle = field_load_file(argv[i], &loaded);
+        if (fle != Field_load_error_ok) {
+            fprintf(stderr, "File load error: %s: %s.\n", argv[i], field_load_error_string(fle));
+            result = 1;
+            continue;
+        }
+        bench_field(argv[i], 1, &loaded, (Usz)ticks, (Usz)rounds, round_ns);
+        if (tiles == 1)
+            continue;
+        if ((Usz)loaded.height * (Usz)tiles > ORCA_Y_MAX ||
+            (Usz)loaded.width * (Usz)tiles > ORCA_X_MAX) {
+            fprintf(stderr, "Skipping tiled run of %s, the grid would be too big.\n", argv[i]);
+            continue;
+        }
+        tile_field(&loaded, (Usz)tiles, &tiled);
+        bench_field(argv[i], (Usz)tiles, &tiled, (Usz)ticks, (Usz)rounds, round_ns);
+    }
+    field_deinit(&loaded);
+    field_deinit(&tiled);
+    free(round_ns);
+    return result;
+}
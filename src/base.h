@@ -83,6 +83,7 @@ extern "C" {
 
     typedef char Glyph;
     typedef U8 Mark;
+    typedef U64 Occword;
 
 //----------------------------------------------------------------------------------------
 // Constants
@@ -0,0 +1,325 @@
+#include "cfield.h"
+#include "gbuffer.h"
+#include <ctype.h>
+
+void cfield_init(Cfield *cf)
+{
+    cf->chunks = NULL;
+    cf->chunk_count = 0;
+    cf->chunk_capacity = 0;
+    cf->slots = NULL;
+    cf->slot_count = 0;
+    cf->height = 0;
+    cf->width = 0;
+}
+
+void cfield_deinit(Cfield *cf)
+{
+    for (Usz i = 0; i < cf->chunk_count; ++i)
+        free(cf->chunks[i].glyphs);
+    free(cf->chunks);
+    free(cf->slots);
+}
+
+static inline bool glyph_char_is_valid(char c)
+{
+    return c >= '!' && c <= '~';
+}
+
+static bool glyphs_all_dots(Glyph const *glyphs, Usz count)
+{
+    for (Usz i = 0; i < count; i += 64) {
+        if (gbuffer_live_bits(glyphs + i, NULL, count - i < 64 ? count - i : 64))
+            return false;
+    }
+    return true;
+}
+
+static inline Usz cfield_home_slot(Cfield const *cf, Usz cy, Usz cx)
+{
+    U64 key = ((U64)cy << 32 | (U64)cx) * UINT64_C(0x9E3779B97F4A7C15);
+    return (Usz)(key >> 32) & (cf->slot_count - 1);
+}
+
+// The slot holding the chunk, or the free slot where it would go.
+static Usz cfield_find_slot(Cfield const *cf, Usz cy, Usz cx)
+{
+    Usz mask = cf->slot_count - 1;
+    for (Usz i = cfield_home_slot(cf, cy, cx);; i = (i + 1) & mask) {
+        U32 slot = cf->slots[i];
+        if (slot == 0)
+            return i;
+        Cfield_chunk const *chunk = cf->chunks + slot - 1;
+        if (chunk->cy == cy && chunk->cx == cx)
+            return i;
+    }
+}
+
+static ORCA_NOINLINE void cfield_rehash(Cfield *cf, Usz slot_count)
+{
+    free(cf->slots);
+    cf->slots = calloc(slot_count, sizeof(U32));
+    cf->slot_count = slot_count;
+    for (Usz i = 0; i < cf->chunk_count; ++i) {
+        Cfield_chunk const *chunk = cf->chunks + i;
+        cf->slots[cfield_find_slot(cf, chunk->cy, chunk->cx)] = (U32)(i + 1);
+    }
+}
+
+Usz cfield_chunk_index(Cfield const *cf, Usz cy, Usz cx)
+{
+    if (cf->chunk_count == 0)
+        return 0;
+    U32 slot = cf->slots[cfield_find_slot(cf, cy, cx)];
+    return slot ? slot - 1 : cf->chunk_count;
+}
+
+Glyph *cfield_chunk(Cfield const *cf, Usz cy, Usz cx)
+{
+    Usz index = cfield_chunk_index(cf, cy, cx);
+    return index < cf->chunk_count ? cf->chunks[index].glyphs : NULL;
+}
+
+Glyph *cfield_chunk_ensure(Cfield *cf, Usz cy, Usz cx)
+{
+    Glyph *glyphs = cfield_chunk(cf, cy, cx);
+    if (glyphs)
+        return glyphs;
+    // Keep the table at most half full.
+    if ((cf->chunk_count + 1) * 2 > cf->slot_count)
+        cfield_rehash(cf, cf->slot_count < 64 ? 64 : cf->slot_count * 2);
+    if (cf->chunk_count == cf->chunk_capacity) {
+        cf->chunk_capacity = cf->chunk_capacity < 16 ? 16 : cf->chunk_capacity * 2;
+        cf->chunks = realloc(cf->chunks, cf->chunk_capacity * sizeof(Cfield_chunk));
+    }
+    glyphs = malloc(Cfield_chunk_cells * sizeof(Glyph));
+    memset(glyphs, '.', Cfield_chunk_cells * sizeof(Glyph));
+    Cfield_chunk *chunk = cf->chunks + cf->chunk_count++;
+    chunk->cy = (U32)cy;
+    chunk->cx = (U32)cx;
+    chunk->glyphs = glyphs;
+    cf->slots[cfield_find_slot(cf, cy, cx)] = (U32)cf->chunk_count;
+    return glyphs;
+}
+
+void cfield_chunk_drop(Cfield *cf, Usz cy, Usz cx)
+{
+    if (cf->chunk_count == 0)
+        return;
+    Usz mask = cf->slot_count - 1;
+    Usz hole = cfield_find_slot(cf, cy, cx);
+    U32 slot = cf->slots[hole];
+    if (slot == 0)
+        return;
+    // Linear probing, so close the gap by pulling back any later entry that
+    // wouldn't be found past it anymore.
+    cf->slots[hole] = 0;
+    for (Usz i = (hole + 1) & mask; cf->slots[i]; i = (i + 1) & mask) {
+        Cfield_chunk const *chunk = cf->chunks + cf->slots[i] - 1;
+        Usz home = cfield_home_slot(cf, chunk->cy, chunk->cx);
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            cf->slots[hole] = cf->slots[i];
+            cf->slots[i] = 0;
+            hole = i;
+        }
+    }
+    // Move the last chunk into the freed place in the list.
+    Usz index = slot - 1, last = cf->chunk_count - 1;
+    free(cf->chunks[index].glyphs);
+    if (index != last) {
+        cf->chunks[index] = cf->chunks[last];
+        cf->slots[cfield_find_slot(cf, cf->chunks[index].cy, cf->chunks[index].cx)] = slot;
+    }
+    --cf->chunk_count;
+}
+
+void cfield_resize(Cfield *cf, Usz height, Usz width)
+{
+    assert(height <= CFIELD_DIM_MAX && width <= CFIELD_DIM_MAX);
+    cf->height = height;
+    cf->width = width;
+    // Backwards, since dropping a chunk moves the last one into its place.
+    for (Usz i = cf->chunk_count; i-- > 0;) {
+        Cfield_chunk *chunk = cf->chunks + i;
+        Usz y0 = (Usz)chunk->cy * Cfield_chunk_size, x0 = (Usz)chunk->cx * Cfield_chunk_size;
+        if (y0 + Cfield_chunk_size <= height && x0 + Cfield_chunk_size <= width)
+            continue;
+        Usz rows = y0 < height ? height - y0 : 0;
+        Usz cols = x0 < width ? width - x0 : 0;
+        if (rows > Cfield_chunk_size)
+            rows = Cfield_chunk_size;
+        if (cols > Cfield_chunk_size)
+            cols = Cfield_chunk_size;
+        for (Usz iy = 0; iy < Cfield_chunk_size; ++iy) {
+            Usz keep = iy < rows ? cols : 0;
+            memset(chunk->glyphs + iy * Cfield_chunk_size + keep, '.', Cfield_chunk_size - keep);
+        }
+        if (glyphs_all_dots(chunk->glyphs, Cfield_chunk_cells))
+            cfield_chunk_drop(cf, chunk->cy, chunk->cx);
+    }
+}
+
+Glyph cfield_peek(Cfield const *cf, Usz y, Usz x)
+{
+    assert(y < cf->height && x < cf->width);
+    Glyph const *glyphs = cfield_chunk(cf, y >> Cfield_chunk_bits, x >> Cfield_chunk_bits);
+    if (!glyphs)
+        return '.';
+    Usz iy = y & (Cfield_chunk_size - 1), ix = x & (Cfield_chunk_size - 1);
+    return glyphs[iy * Cfield_chunk_size + ix];
+}
+
+void cfield_poke(Cfield *cf, Usz y, Usz x, Glyph g)
+{
+    cfield_write_rect(cf, y, x, 1, 1, &g);
+}
+
+void cfield_read_rect(Cfield const *cf, Usz y, Usz x, Usz height, Usz width, Glyph *dest)
+{
+    assert(y + height <= cf->height && x + width <= cf->width);
+    if (height == 0 || width == 0)
+        return;
+    Usz cy_end = ((y + height - 1) >> Cfield_chunk_bits) + 1;
+    Usz cx_end = ((x + width - 1) >> Cfield_chunk_bits) + 1;
+    for (Usz cy = y >> Cfield_chunk_bits; cy < cy_end; ++cy) {
+        Usz y0 = cy * Cfield_chunk_size, y1 = y0 + Cfield_chunk_size;
+        if (y0 < y)
+            y0 = y;
+        if (y1 > y + height)
+            y1 = y + height;
+        for (Usz cx = x >> Cfield_chunk_bits; cx < cx_end; ++cx) {
+            Usz x0 = cx * Cfield_chunk_size, x1 = x0 + Cfield_chunk_size;
+            if (x0 < x)
+                x0 = x;
+            if (x1 > x + width)
+                x1 = x + width;
+            Glyph const *glyphs = cfield_chunk(cf, cy, cx);
+            for (Usz iy = y0; iy < y1; ++iy) {
+                Glyph *drow = dest + (iy - y) * width + (x0 - x);
+                if (glyphs)
+                    memcpy(
+                        drow,
+                        glyphs + (iy - cy * Cfield_chunk_size) * Cfield_chunk_size +
+                            (x0 - cx * Cfield_chunk_size),
+                        (x1 - x0) * sizeof(Glyph));
+                else
+                    memset(drow, '.', (x1 - x0) * sizeof(Glyph));
+            }
+        }
+    }
+}
+
+void cfield_write_rect(Cfield *cf, Usz y, Usz x, Usz height, Usz width, Glyph const *src)
+{
+    assert(y + height <= cf->height && x + width <= cf->width);
+    if (height == 0 || width == 0)
+        return;
+    Usz cy_end = ((y + height - 1) >> Cfield_chunk_bits) + 1;
+    Usz cx_end = ((x + width - 1) >> Cfield_chunk_bits) + 1;
+    for (Usz cy = y >> Cfield_chunk_bits; cy < cy_end; ++cy) {
+        Usz y0 = cy * Cfield_chunk_size, y1 = y0 + Cfield_chunk_size;
+        if (y0 < y)
+            y0 = y;
+        if (y1 > y + height)
+            y1 = y + height;
+        for (Usz cx = x >> Cfield_chunk_bits; cx < cx_end; ++cx) {
+            Usz x0 = cx * Cfield_chunk_size, x1 = x0 + Cfield_chunk_size;
+            if (x0 < x)
+                x0 = x;
+            if (x1 > x + width)
+                x1 = x + width;
+            bool has_glyphs = false;
+            for (Usz iy = y0; iy < y1 && !has_glyphs; ++iy)
+                has_glyphs = !glyphs_all_dots(src + (iy - y) * width + (x0 - x), x1 - x0);
+            Glyph *glyphs =
+                has_glyphs ? cfield_chunk_ensure(cf, cy, cx) : cfield_chunk(cf, cy, cx);
+            if (!glyphs)
+                continue;
+            for (Usz iy = y0; iy < y1; ++iy) {
+                memcpy(
+                    glyphs + (iy - cy * Cfield_chunk_size) * Cfield_chunk_size +
+                        (x0 - cx * Cfield_chunk_size),
+                    src + (iy - y) * width + (x0 - x),
+                    (x1 - x0) * sizeof(Glyph));
+            }
+            if (!has_glyphs && glyphs_all_dots(glyphs, Cfield_chunk_cells))
+                cfield_chunk_drop(cf, cy, cx);
+        }
+    }
+}
+
+Field_load_error cfield_load_file(char const *filepath, Cfield *cf)
+{
+    FILE *file = fopen(filepath, "r");
+    if (file == NULL) {
+        return Field_load_error_cant_open_file;
+    }
+    cfield_resize(cf, 0, 0);
+    char *buf = NULL;
+    Usz buf_capacity = 0;
+    Usz first_row_columns = 0;
+    Usz rows = 0;
+    Field_load_error result = Field_load_error_ok;
+    for (;;) {
+        // Read a whole line, however long.
+        Usz len = 0;
+        for (;;) {
+            if (buf_capacity - len < 4096) {
+                buf_capacity = buf_capacity < 4096 ? 8192 : buf_capacity * 2;
+                buf = realloc(buf, buf_capacity);
+            }
+            if (!fgets(buf + len, (int)(buf_capacity - len), file))
+                break;
+            len += strlen(buf + len);
+            if (buf[len - 1] == '\n')
+                break;
+        }
+        if (len == 0)
+            break;
+        if (rows == CFIELD_DIM_MAX) {
+            result = Field_load_error_too_many_rows;
+            break;
+        }
+        while (len > 0 && isspace(buf[len - 1]))
+            --len;
+        if (len == 0)
+            continue;
+        if (len > CFIELD_DIM_MAX) {
+            result = Field_load_error_too_many_columns;
+            break;
+        }
+        if (rows == 0) {
+            first_row_columns = len;
+        } else if (len != first_row_columns) {
+            result = Field_load_error_not_a_rectangle;
+            break;
+        }
+        for (Usz i = 0; i < len; ++i) {
+            if (!glyph_char_is_valid(buf[i]))
+                buf[i] = '.';
+        }
+        cf->height = rows + 1;
+        cf->width = first_row_columns;
+        cfield_write_rect(cf, rows, 0, 1, len, buf);
+        ++rows;
+    }
+    free(buf);
+    fclose(file);
+    return result;
+}
+
+void cfield_fput(Cfield const *cf, FILE *stream)
+{
+    Usz width = cf->width;
+    char *row = malloc(width + 1);
+    row[width] = '\n';
+    for (Usz iy = 0; iy < cf->height; ++iy) {
+        cfield_read_rect(cf, iy, 0, 1, width, row);
+        for (Usz ix = 0; ix < width; ++ix) {
+            if (!glyph_char_is_valid(row[ix]))
+                row[ix] = '?';
+        }
+        fwrite(row, 1, width + 1, stream);
+    }
+    free(row);
+}
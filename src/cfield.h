@@ -0,0 +1,66 @@
+#pragma once
+#include "base.h"
+#include "field.h" // Field_load_error
+#include <stdio.h>
+
+// Chunked storage for grids too big to keep in one dense buffer, or bigger
+// than Field's U16 dimensions allow. The grid is cut into square chunks of
+// Cfield_chunk_size cells on a side, and only the chunks holding something
+// other than '.' get allocated. They're found through a hash table keyed by
+// chunk coordinates, so a huge, mostly empty canvas costs memory in
+// proportion to what's on it. The VM runs on one with orca_run_cfield() (see
+// sim.h).
+//
+// Chunks along the bottom and right edges can hang off the grid. The cells
+// out there stay '.'.
+
+enum
+{
+    Cfield_chunk_bits = 6, // A chunk row is one Occword of live bits (see gbuffer.h)
+    Cfield_chunk_size = 1 << Cfield_chunk_bits,
+    Cfield_chunk_cells = Cfield_chunk_size * Cfield_chunk_size,
+};
+
+// Chunk coordinates are kept in U32s.
+#define CFIELD_DIM_MAX ((Usz)UINT32_MAX)
+
+typedef struct {
+    U32 cy, cx;
+    Glyph *glyphs; // Cfield_chunk_cells of them, row-major
+} Cfield_chunk;
+
+typedef struct {
+    Cfield_chunk *chunks; // In no particular order
+    Usz chunk_count, chunk_capacity;
+    U32 *slots; // Open addressing table of indices into chunks, plus 1 so 0 is free
+    Usz slot_count; // A power of 2, or 0
+    Usz height, width;
+} Cfield;
+
+void cfield_init(Cfield *cf);
+void cfield_deinit(Cfield *cf);
+// Cells that end up outside the new dimensions are dropped, and new ones are
+// '.'.
+void cfield_resize(Cfield *cf, Usz height, Usz width);
+
+// The chunk at chunk coordinates cy, cx, or NULL if it's all '.'.
+Glyph *cfield_chunk(Cfield const *cf, Usz cy, Usz cx);
+// Same, as an index into chunks, or chunk_count if it's all '.'.
+Usz cfield_chunk_index(Cfield const *cf, Usz cy, Usz cx);
+// Same, but allocates it (filled with '.') if it isn't there.
+Glyph *cfield_chunk_ensure(Cfield *cf, Usz cy, Usz cx);
+void cfield_chunk_drop(Cfield *cf, Usz cy, Usz cx);
+
+Glyph cfield_peek(Cfield const *cf, Usz y, Usz x);
+void cfield_poke(Cfield *cf, Usz y, Usz x, Glyph g);
+
+// Copy a rectangle of the grid to or from a dense buffer of height * width
+// glyphs. The rectangle must be inside the grid. Writing allocates the chunks
+// it puts something other than '.' in, and drops the ones it leaves empty.
+void cfield_read_rect(Cfield const *cf, Usz y, Usz x, Usz height, Usz width, Glyph *dest);
+void cfield_write_rect(Cfield *cf, Usz y, Usz x, Usz height, Usz width, Glyph const *src);
+
+// Same file format as field_load_file(), with no limit on the size other
+// than CFIELD_DIM_MAX. Only one row is ever held in memory.
+Field_load_error cfield_load_file(char const *filepath, Cfield *cf);
+void cfield_fput(Cfield const *cf, FILE *stream);
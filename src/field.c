@@ -174,6 +174,7 @@ char const *field_load_error_string(Field_load_error fle)
 void markbuf_init(MarkBuf *mbr)
 {
     mbr->buffer = NULL;
+    mbr->dirty = NULL;
     mbr->capacity = 0;
 }
 
@@ -181,12 +182,69 @@ void markbuf_ensure_size(MarkBuf *mbr, Usz height, Usz width)
 {
     Usz capacity = height * width;
     if (mbr->capacity < capacity) {
+        Usz runs = mbuffer_dirty_runs(capacity);
         mbr->buffer = realloc(mbr->buffer, capacity);
+        mbr->dirty = realloc(mbr->dirty, runs);
         mbr->capacity = capacity;
+        // The new memory could hold anything, so the next clear does all of it.
+        memset(mbr->dirty, 1, runs);
     }
 }
 
+void markbuf_clear(MarkBuf *mbr)
+{
+    // The whole capacity, not just the current dimensions: runs past the end
+    // of a shrunken grid stay dirty until they are cleared here.
+    mbuffer_clear_dirty(mbr->buffer, mbr->dirty, mbr->capacity);
+}
+
 void markbuf_deinit(MarkBuf *mbr)
 {
     free(mbr->buffer);
+    free(mbr->dirty);
+}
+
+void occbuf_init(OccBuf *obr)
+{
+    obr->buffer = NULL;
+    obr->capacity = 0;
+    obr->height = 0;
+    obr->width = 0;
+    obr->is_valid = false;
+}
+
+void occbuf_invalidate(OccBuf *obr)
+{
+    obr->is_valid = false;
+}
+
+void occbuf_mark_subrect(OccBuf *obr, Usz y, Usz x, Usz height, Usz width)
+{
+    // Nothing to keep up to date if the next sync is going to rebuild anyway.
+    if (!obr->is_valid)
+        return;
+    obuffer_mark_subrect(obr->buffer, obr->height, obr->width, y, x, height, width);
+}
+
+Occword *occbuf_sync(OccBuf *obr, Field const *field)
+{
+    Usz height = field->height;
+    Usz width = field->width;
+    if (obr->is_valid && obr->height == height && obr->width == width)
+        return obr->buffer;
+    Usz capacity = height * obuffer_row_words(width);
+    if (obr->capacity < capacity) {
+        obr->buffer = realloc(obr->buffer, capacity * sizeof(Occword));
+        obr->capacity = capacity;
+    }
+    obuffer_rebuild(obr->buffer, field->buffer, height, width);
+    obr->height = height;
+    obr->width = width;
+    obr->is_valid = true;
+    return obr->buffer;
+}
+
+void occbuf_deinit(OccBuf *obr)
+{
+    free(obr->buffer);
 }
@@ -9,12 +9,32 @@
 // the 'Field*' buffer, since it uses them together.) There are no procedures
 // for saving/loading Mark* buffers to/from disk, since we currently don't need
 // that functionality.
+//
+// It also carries a dirty map (see mbuffer_dirty_* in gbuffer.h), which the
+// VM keeps up to date as it writes marks. markbuf_clear() uses them to zero
+// only what the last tick touched. Marks are still plain Mark values, so the
+// renderer can keep reading them straight out of the buffer.
 
 typedef struct MarkBuf {
     Mark *buffer;
+    U8 *dirty;
     Usz capacity;
 } MarkBuf;
 
+// Occupancy bitmaps for a Field (see obuffer_* in gbuffer.h), so the VM can
+// skip over empty parts of the grid without looking at them. Code that edits
+// the field marks what it wrote with occbuf_mark_subrect(). Code that replaces
+// the field wholesale (loading a file, undo, resizing) calls occbuf_invalidate()
+// instead, and occbuf_sync() then rebuilds the bitmaps from the glyphs before
+// they are next used. A change of field dimensions also forces a rebuild.
+
+typedef struct OccBuf {
+    Occword *buffer;
+    Usz capacity;
+    Usz height, width;
+    bool is_valid;
+} OccBuf;
+
 // A reusable buffer for glyphs, stored with its dimensions. Also some helpers
 // for loading/saving from files and doing common operations that a UI layer
 // might want to do. Not used by the VM.
@@ -48,8 +68,15 @@ char const *field_load_error_string(Field_load_error fle);
 
 void markbuf_init(MarkBuf *mbr);
 void markbuf_ensure_size(MarkBuf *mbr, Usz height, Usz width);
+void markbuf_clear(MarkBuf *mbr);
 void markbuf_deinit(MarkBuf *mbr);
 
+void occbuf_init(OccBuf *obr);
+void occbuf_invalidate(OccBuf *obr);
+void occbuf_mark_subrect(OccBuf *obr, Usz y, Usz x, Usz height, Usz width);
+Occword *occbuf_sync(OccBuf *obr, Field const *field);
+void occbuf_deinit(OccBuf *obr);
+
 // ------------------------------------------------------------
 // FIELD-UNDO
 // ------------------------------------------------------------
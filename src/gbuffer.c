@@ -1,5 +1,11 @@
 #include "gbuffer.h"
 
+#if !defined(FEAT_NOSIMD) && (defined(__GNUC__) || defined(__clang__)) &&                          \
+    (defined(__x86_64__) || defined(__i386__))
+    #define GBUFFER_X86_SIMD
+    #include <immintrin.h>
+#endif
+
 void gbuffer_copy_subrect(
     Glyph *src,
     Glyph *dest,
@@ -175,3 +181,189 @@ void mbuffer_clear(Mark *mbuf, Usz height, Usz width)
     Usz cleared_size = height * width;
     memset(mbuf, 0, cleared_size);
 }
+
+void mbuffer_clear_dirty(Mark *mbuf, U8 *dirty, Usz count)
+{
+    Usz runs = mbuffer_dirty_runs(count);
+    for (Usz i = 0; i < runs;) {
+        if (!dirty[i]) {
+            ++i;
+            continue;
+        }
+        // Neighboring dirty runs get zeroed with a single memset.
+        Usz first = i;
+        while (i < runs && dirty[i])
+            ++i;
+        memset(dirty + first, 0, i - first);
+        Usz end = i * 64;
+        if (end > count)
+            end = count;
+        memset(mbuf + first * 64, 0, end - first * 64);
+    }
+}
+
+//////// Live cell scanning
+
+typedef Occword (*Live_bits_fn)(Glyph const *grow, Mark const *mrow, Usz count);
+
+// Reference implementation. Also handles the leftovers of the other versions.
+static Occword live_bits_scalar(Glyph const *grow, Mark const *mrow, Usz count)
+{
+    Occword bits = 0;
+    for (Usz i = 0; i < count; ++i) {
+        bool live = grow[i] != '.';
+        if (mrow && mrow[i] & (Mark_flag_lock | Mark_flag_sleep))
+            live = false;
+        bits |= (Occword)live << i;
+    }
+    return bits;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+// 8 cells at a time in a plain 64-bit integer, for when there's no vector
+// version. Each byte's top bit ends up saying whether the cell is live, and
+// the multiply gathers the 8 top bits into the low byte.
+static Occword live_bits_swar(Glyph const *grow, Mark const *mrow, Usz count)
+{
+    U64 const lows = UINT64_C(0x7F7F7F7F7F7F7F7F);
+    U64 const highs = UINT64_C(0x8080808080808080);
+    U64 const dots = UINT64_C(0x0101010101010101) * '.';
+    U64 const stopped = UINT64_C(0x0101010101010101) * (Mark_flag_lock | Mark_flag_sleep);
+    Occword bits = 0;
+    Usz i = 0;
+    for (; i + 8 <= count; i += 8) {
+        U64 g, m;
+        memcpy(&g, grow + i, sizeof g);
+        g ^= dots;
+        U64 live = (((g & lows) + lows) | g) & highs; // top bit set if not '.'
+        if (mrow) {
+            memcpy(&m, mrow + i, sizeof m);
+            live &= ~((m & stopped) + lows); // top bit set if lock or sleep
+        }
+        bits |= (((live >> 7) * UINT64_C(0x0102040810204080)) >> 56) << i;
+    }
+    if (i < count)
+        bits |= live_bits_scalar(grow + i, mrow ? mrow + i : NULL, count - i) << i;
+    return bits;
+}
+    #define LIVE_BITS_PORTABLE live_bits_swar
+#else
+    #define LIVE_BITS_PORTABLE live_bits_scalar
+#endif
+
+#ifdef GBUFFER_X86_SIMD
+__attribute__((target("sse2"))) static Occword
+    live_bits_sse2(Glyph const *grow, Mark const *mrow, Usz count)
+{
+    __m128i const dots = _mm_set1_epi8('.');
+    __m128i const stopped = _mm_set1_epi8(Mark_flag_lock | Mark_flag_sleep);
+    __m128i const zero = _mm_setzero_si128();
+    Occword bits = 0;
+    Usz i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i g = _mm_loadu_si128((__m128i const *)(grow + i));
+        U32 live = ~(U32)_mm_movemask_epi8(_mm_cmpeq_epi8(g, dots)) & 0xFFFFu;
+        if (mrow) {
+            __m128i m = _mm_loadu_si128((__m128i const *)(mrow + i));
+            live &= (U32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(m, stopped), zero));
+        }
+        bits |= (Occword)live << i;
+    }
+    if (i < count)
+        bits |= live_bits_scalar(grow + i, mrow ? mrow + i : NULL, count - i) << i;
+    return bits;
+}
+
+__attribute__((target("avx2"))) static Occword
+    live_bits_avx2(Glyph const *grow, Mark const *mrow, Usz count)
+{
+    __m256i const dots = _mm256_set1_epi8('.');
+    __m256i const stopped = _mm256_set1_epi8(Mark_flag_lock | Mark_flag_sleep);
+    __m256i const zero = _mm256_setzero_si256();
+    Occword bits = 0;
+    Usz i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i g = _mm256_loadu_si256((__m256i const *)(grow + i));
+        U32 live = ~(U32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(g, dots));
+        if (mrow) {
+            __m256i m = _mm256_loadu_si256((__m256i const *)(mrow + i));
+            live &= (U32)_mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(_mm256_and_si256(m, stopped), zero));
+        }
+        bits |= (Occword)live << i;
+    }
+    if (i < count)
+        bits |= live_bits_sse2(grow + i, mrow ? mrow + i : NULL, count - i) << i;
+    return bits;
+}
+#endif
+
+// SSE4.2 has nothing to offer over SSE2 for a byte compare and movemask, so
+// there is no separate version for it.
+static Occword live_bits_resolve(Glyph const *grow, Mark const *mrow, Usz count);
+static Live_bits_fn live_bits_impl = live_bits_resolve;
+
+static Occword live_bits_resolve(Glyph const *grow, Mark const *mrow, Usz count)
+{
+    Live_bits_fn fn = LIVE_BITS_PORTABLE;
+#ifdef GBUFFER_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        fn = live_bits_avx2;
+    else if (__builtin_cpu_supports("sse2"))
+        fn = live_bits_sse2;
+#endif
+    live_bits_impl = fn;
+    return fn(grow, mrow, count);
+}
+
+Occword gbuffer_live_bits(Glyph const *grow, Mark const *mrow, Usz count)
+{
+    assert(count <= 64);
+    return live_bits_impl(grow, mrow, count);
+}
+
+void obuffer_mark_subrect(Occword *obuf, Usz f_height, Usz f_width, Usz y, Usz x, Usz height, Usz width)
+{
+    if (y >= f_height || x >= f_width)
+        return;
+    Usz rows = f_height - y;
+    if (height < rows)
+        rows = height;
+    Usz columns = f_width - x;
+    if (width < columns)
+        columns = width;
+    if (rows == 0 || columns == 0)
+        return;
+    Usz row_words = obuffer_row_words(f_width);
+    Usz x_end = x + columns; // one past the last column
+    Usz w0 = x / 64;
+    Usz w1 = (x_end - 1) / 64;
+    Occword head = ~(Occword)0 << (x % 64);
+    Occword tail = ~(Occword)0 >> (63 - (x_end - 1) % 64);
+    Occword *row = obuf + y * row_words;
+    for (Usz iy = 0; iy < rows; ++iy, row += row_words) {
+        if (w0 == w1) {
+            row[w0] |= head & tail;
+            continue;
+        }
+        row[w0] |= head;
+        for (Usz iw = w0 + 1; iw < w1; ++iw)
+            row[iw] = ~(Occword)0;
+        row[w1] |= tail;
+    }
+}
+
+void obuffer_rebuild(Occword *obuf, Glyph const *gbuf, Usz height, Usz width)
+{
+    Usz row_words = obuffer_row_words(width);
+    for (Usz iy = 0; iy < height; ++iy) {
+        Glyph const *grow = gbuf + iy * width;
+        Occword *orow = obuf + iy * row_words;
+        for (Usz iw = 0; iw < row_words; ++iw) {
+            Usz x0 = iw * 64;
+            Usz count = width - x0 < 64 ? width - x0 : 64;
+            orow[iw] = gbuffer_live_bits(grow + x0, NULL, count);
+        }
+    }
+}
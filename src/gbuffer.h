@@ -60,3 +60,56 @@ void mbuffer_poke_relative_flags_or(
 
 void mbuffer_clear(Mark *mbuf, Usz height, Usz width);
 
+// Dirty maps for a mark buffer: one byte per run of 64 marks, in buffer order
+// (runs don't care where rows start), nonzero when any mark in the run might
+// be nonzero. The VM sets them as it writes marks, so mbuffer_clear_dirty()
+// only has to zero the runs a tick actually touched instead of the whole
+// buffer. 'count' is how many marks the map covers. Bytes rather than bits,
+// because a plain store is noticeably cheaper than a read-modify-write on
+// every PORT.
+
+static inline Usz mbuffer_dirty_runs(Usz count)
+{
+    return (count + 63) / 64;
+}
+
+static ORCA_FORCEINLINE void mbuffer_dirty_mark(U8 *dirty, Usz offs)
+{
+    dirty[offs / 64] = 1;
+}
+
+// Same, for the 'count' marks starting at 'offs'.
+static ORCA_FORCEINLINE void mbuffer_dirty_mark_range(U8 *dirty, Usz offs, Usz count)
+{
+    for (Usz run = offs / 64, end = (offs + count + 63) / 64; run < end; ++run)
+        dirty[run] = 1;
+}
+
+void mbuffer_clear_dirty(Mark *mbuf, U8 *dirty, Usz count);
+
+// Returns one bit per cell for up to 64 cells of a row (bit i is cell i),
+// set if the glyph isn't '.' and, when mrow isn't NULL, the mark has neither
+// Mark_flag_lock nor Mark_flag_sleep. Bits at and above count are zero. Uses
+// SSE2 or AVX2 when the CPU has them, picked on the first call, and a
+// portable 8-at-a-time version otherwise or when built with FEAT_NOSIMD.
+Occword gbuffer_live_bits(Glyph const *grow, Mark const *mrow, Usz count);
+
+// Occupancy bitmaps: one bit per grid cell, each row padded out to a whole
+// number of words. A clear bit means the cell is definitely '.', a set bit
+// means it might not be. Stale set bits are harmless, the VM clears them when
+// it finds a '.' underneath.
+
+static inline Usz obuffer_row_words(Usz width)
+{
+    return (width + 63) / 64;
+}
+
+static ORCA_FORCEINLINE void obuffer_mark(Occword *obuf, Usz width, Usz y, Usz x)
+{
+    obuf[y * obuffer_row_words(width) + x / 64] |= (Occword)1 << (x % 64);
+}
+
+void obuffer_mark_subrect(Occword *obuf, Usz f_height, Usz f_width, Usz y, Usz x, Usz height, Usz width);
+
+void obuffer_rebuild(Occword *obuf, Glyph const *gbuf, Usz height, Usz width);
+
@@ -1,7 +1,6 @@
 #include "ged.h"
 #include "gbuffer.h"
 #include "sim.h"
-#include "sokol_time.h"
 
 typedef enum
 {
@@ -168,193 +167,51 @@ void advance_faketab(WINDOW *win, int offset_x, int tabstop)
     wmove(win, y, x);
 }
 
-void apply_time_to_sustained_notes(
-    Oosc_dev *oosc_dev,
-    Midi_mode *midi_mode,
-    double time_elapsed,
-    Susnote_list *susnote_list,
-    double *next_note_off_deadline)
+void ged_cursor_init(Ged_cursor *tc)
 {
-    Usz start_removed, end_removed;
-    susnote_list_advance_time(
-        susnote_list,
-        time_elapsed,
-        &start_removed,
-        &end_removed,
-        next_note_off_deadline);
-    if (ORCA_UNLIKELY(start_removed != end_removed)) {
-        Susnote const *restrict susnotes_off = susnote_list->buffer;
-        send_midi_note_offs(oosc_dev, midi_mode, susnotes_off + start_removed, susnotes_off + end_removed);
-    }
+    tc->x = tc->y = 0;
+    tc->w = tc->h = 1;
 }
 
-// The way orca handles MIDI sustains, timing, and overlapping note-ons (plus
-// the 'mono' thing being added) has changed multiple times over time. Now we
-// are in a situation where this function is a complete mess and needs an
-// overhaul. If you see something in the function below and think, "wait, that
-// seems redundant/weird", that's because it is, not because there's a good
-// reason.
-void send_output_events(
-    Oosc_dev *oosc_dev,
-    Midi_mode *midi_mode,
-    Usz bpm,
-    Susnote_list *susnote_list,
-    Oevent const *events,
-    Usz count)
+static void ged_sim_init(Ged_sim *sim)
 {
-    enum
-    {
-        Midi_on_capacity = 512
-    };
-    typedef struct {
-        U8 channel;
-        U8 note_number;
-        U8 velocity;
-    } Midi_note_on;
-    typedef struct {
-        U8 note_number;
-        U8 velocity;
-        U8 duration;
-    } Midi_mono_on;
-    Midi_note_on midi_note_ons[Midi_on_capacity];
-    Midi_mono_on midi_mono_ons[16]; // Keep only a single one per channel
-    Susnote new_susnotes[Midi_on_capacity];
-    Usz midi_note_count = 0;
-    Usz monofied_chans = 0; // bitset of channels with new mono notes
-    double frame_secs = 60.0 / (double)bpm / 4.0;
-
-    for (Usz i = 0; i < count; ++i) {
-        Oevent const *e = events + i;
-        switch ((Oevent_types)e->any.oevent_type) {
-            case Oevent_type_midi_note: {
-                if (midi_note_count == Midi_on_capacity)
-                    break;
-                Oevent_midi_note const *em = &e->midi_note;
-                Usz note_number = (Usz)(12u * em->octave + em->note);
-                if (note_number > 127)
-                    note_number = 127;
-                Usz channel = em->channel;
-                if (channel > 15)
-                    break;
-                if (em->mono) {
-                    // 'mono' note-ons are strange. The more typical branch you'd expect to
-                    // see, where you can play multiple notes per channel, is below.
-                    monofied_chans |= 1u << (channel & 0xFu);
-                    midi_mono_ons[channel] = (Midi_mono_on){ .note_number = (U8)note_number,
-                                                             .velocity = em->velocity,
-                                                             .duration = em->duration };
-                } else {
-                    midi_note_ons[midi_note_count] = (Midi_note_on){ .channel = (U8)channel,
-                                                                     .note_number = (U8)note_number,
-                                                                     .velocity = em->velocity };
-                    new_susnotes[midi_note_count] = (Susnote){
-                        .remaining = (float)(frame_secs * (double)em->duration),
-                        .chan_note = (U16)((channel << 8u) | note_number)
-                    };
-                    ++midi_note_count;
-                }
-                break;
-            }
-            case Oevent_type_midi_cc: {
-                Oevent_midi_cc const *ec = &e->midi_cc;
-                // Note that we're not preserving the exact order of MIDI events as
-                // emitted by the orca VM. Notes and CCs that are emitted in the same
-                // step will always have the CCs sent first. Not sure if this is OK or
-                // not. If it's not OK, we can either loop again a second time to always
-                // send CCs after notes, or if that's not also OK, we can make the stack
-                // buffer more complicated and interleave the CCs in it.
-                send_midi_chan_msg(oosc_dev, midi_mode, 0xb, ec->channel, ec->control, ec->value);
-                break;
-            }
-            case Oevent_type_midi_pb: {
-                Oevent_midi_pb const *ep = &e->midi_pb;
-                // Same caveat regarding ordering with MIDI CC also applies here.
-                send_midi_chan_msg(oosc_dev, midi_mode, 0xe, ep->channel, ep->lsb, ep->msb);
-                break;
-            }
-            case Oevent_type_osc_ints: {
-                // kinda lame
-                if (!oosc_dev)
-                    continue;
-                Oevent_osc_ints const *eo = &e->osc_ints;
-                char path[] = { '/', eo->glyph, '\0' };
-                I32 ints[ORCA_ARRAY_COUNTOF(eo->numbers)];
-                Usz nnum = eo->count;
-                for (Usz inum = 0; inum < nnum; ++inum) {
-                    ints[inum] = eo->numbers[inum];
-                }
-                oosc_send_int32s(oosc_dev, path, ints, nnum);
-                break;
-            }
-            case Oevent_type_udp_string: {
-                if (!oosc_dev)
-                    continue;
-                Oevent_udp_string const *eo = &e->udp_string;
-                oosc_send_datagram(oosc_dev, eo->chars, eo->count);
-                break;
-            }
-        }
-    }
+    field_init(&sim->field);
+    markbuf_init(&sim->mbuf_r);
+    occbuf_init(&sim->obuf_r);
+    oprog_init(&sim->prog);
+    oevent_list_init(&sim->oevent_list);
+    sim->tick_num = 0;
+    sim->events_total = 0;
+    sim->seq = 0;
+#ifdef FEAT_PROFILE
+    memset(&sim->prof, 0, sizeof(sim->prof));
+#endif
+}
 
-do_note_ons:
-    if (midi_note_count > 0) {
-        Usz start_note_offs, end_note_offs;
-        susnote_list_add_notes(
-            susnote_list,
-            new_susnotes,
-            midi_note_count,
-            &start_note_offs,
-            &end_note_offs);
-        if (start_note_offs != end_note_offs) {
-            Susnote const *restrict susnotes_off = susnote_list->buffer;
-            send_midi_note_offs(
-                oosc_dev,
-                midi_mode,
-                susnotes_off + start_note_offs,
-                susnotes_off + end_note_offs);
-        }
-        for (Usz i = 0; i < midi_note_count; ++i) {
-            Midi_note_on mno = midi_note_ons[i];
-            send_midi_chan_msg(oosc_dev, midi_mode, 0x9, mno.channel, mno.note_number, mno.velocity);
-        }
-    }
-    if (monofied_chans) {
-        // The behavior we end up with is that if regular note-ons are played in
-        // the same frame/step as a mono, the regular note-ons will have the actual
-        // MIDI note on sent, followed immediately by a MIDI note off. I don't know
-        // if this is good or not.
-        Usz start_note_offs, end_note_offs;
-        susnote_list_remove_by_chan_mask(susnote_list, monofied_chans, &start_note_offs, &end_note_offs);
-        if (start_note_offs != end_note_offs) {
-            Susnote const *restrict susnotes_off = susnote_list->buffer;
-            send_midi_note_offs(
-                oosc_dev,
-                midi_mode,
-                susnotes_off + start_note_offs,
-                susnotes_off + end_note_offs);
-        }
-        midi_note_count = 0;           // We're going to use this list again. Reset it.
-        for (Usz i = 0; i < 16; i++) { // Add these notes to list of note-ons
-            if (!(monofied_chans & 1u << i))
-                continue;
-            midi_note_ons[midi_note_count] = (Midi_note_on){ .channel = (U8)i,
-                                                             .note_number = midi_mono_ons[i].note_number,
-                                                             .velocity = midi_mono_ons[i].velocity };
-            new_susnotes[midi_note_count] = (Susnote){
-                .remaining = (float)(frame_secs * (double)midi_mono_ons[i].duration),
-                .chan_note = (U16)((i << 8u) | midi_mono_ons[i].note_number)
-            };
-            midi_note_count++;
-        }
-        monofied_chans = false;
-        goto do_note_ons; // lol super wasteful for doing susnotes again
-    }
+static void ged_sim_deinit(Ged_sim *sim)
+{
+    field_deinit(&sim->field);
+    markbuf_deinit(&sim->mbuf_r);
+    occbuf_deinit(&sim->obuf_r);
+    oprog_deinit(&sim->prog);
+    oevent_list_deinit(&sim->oevent_list);
 }
 
-void ged_cursor_init(Ged_cursor *tc)
+static void ged_frame_init(Ged_frame *frame)
 {
-    tc->x = tc->y = 0;
-    tc->w = tc->h = 1;
+    field_init(&frame->field);
+    markbuf_init(&frame->mbuf_r);
+    oevent_list_init(&frame->oevent_list);
+    frame->tick_num = 0;
+    frame->events_total = 0;
+    frame->seq = 0;
+}
+
+static void ged_frame_deinit(Ged_frame *frame)
+{
+    field_deinit(&frame->field);
+    markbuf_deinit(&frame->mbuf_r);
+    oevent_list_deinit(&frame->oevent_list);
 }
 
 void ged_init(Ged *a, Usz undo_limit, Usz init_bpm, Usz init_seed)
@@ -363,19 +220,37 @@ void ged_init(Ged *a, Usz undo_limit, Usz init_bpm, Usz init_seed)
     field_init(&a->scratch_field);
     field_init(&a->clipboard_field);
     markbuf_init(&a->mbuf_r);
+    occbuf_init(&a->obuf_r);
+    oprog_init(&a->prog);
     undo_history_init(&a->undo_hist, undo_limit);
     oevent_list_init(&a->oevent_list);
     oevent_list_init(&a->scratch_oevent_list);
-    susnote_list_init(&a->susnote_list);
+    susnote_table_init(&a->susnotes);
     ged_cursor_init(&a->ged_cursor);
     a->tick_num = 0;
     a->ruler_spacing_y = a->ruler_spacing_x = 8;
     a->input_mode = Ged_input_mode_normal;
     a->bpm = init_bpm;
-    a->clock = 0;
-    a->accum_secs = 0.0;
-    a->time_to_next_note_off = 1.0;
+    a->lookahead_ms = 0;
+    play_clock_init(&a->play_clock);
+    a->ticker = NULL;
+    ged_sim_init(&a->sim);
+    a->sim_cmds.cmds = NULL;
+    a->sim_cmds.glyphs = NULL;
+    a->sim_cmds.count = a->sim_cmds.capacity = 0;
+    a->sim_cmds.glyph_count = a->sim_cmds.glyph_capacity = 0;
+    a->sim_cmds.seq = 0;
+    for (Usz i = 0; i < ORCA_ARRAY_COUNTOF(a->frames); ++i)
+        ged_frame_init(&a->frames[i]);
+    a->frame_back = 0;
+    a->frame_ready = 1;
+    a->frame_front = 2;
+    a->is_frame_ready = false;
+    a->frame_events_total = 0;
     a->oosc_dev = NULL;
+    a->osc_dests = NULL;
+    a->osc_dest_count = 0;
+    a->net_shm = NULL;
     midi_mode_init_null(&a->midi_mode);
     a->activity_counter = 0;
     a->random_seed = init_seed;
@@ -384,7 +259,6 @@ void ged_init(Ged *a, Usz undo_limit, Usz init_bpm, Usz init_seed)
     a->softmargin_y = a->softmargin_x = 0;
     a->grid_h = 0;
     a->grid_scroll_y = a->grid_scroll_x = 0;
-    a->midi_bclock_sixths = 0;
     a->needs_remarking = true;
     a->is_draw_dirty = false;
     a->is_playing = false;
@@ -393,6 +267,7 @@ void ged_init(Ged *a, Usz undo_limit, Usz init_bpm, Usz init_seed)
     a->is_mouse_down = false;
     a->is_mouse_dragging = false;
     a->is_hud_visible = false;
+    a->is_osc_bundling = false;
 }
 
 void ged_deinit(Ged *a)
@@ -401,27 +276,223 @@ void ged_deinit(Ged *a)
     field_deinit(&a->scratch_field);
     field_deinit(&a->clipboard_field);
     markbuf_deinit(&a->mbuf_r);
+    occbuf_deinit(&a->obuf_r);
+    oprog_deinit(&a->prog);
     undo_history_deinit(&a->undo_hist);
     oevent_list_deinit(&a->oevent_list);
     oevent_list_deinit(&a->scratch_oevent_list);
-    susnote_list_deinit(&a->susnote_list);
+    ged_sim_deinit(&a->sim);
+    free(a->sim_cmds.cmds);
+    free(a->sim_cmds.glyphs);
+    for (Usz i = 0; i < ORCA_ARRAY_COUNTOF(a->frames); ++i)
+        ged_frame_deinit(&a->frames[i]);
     if (a->oosc_dev)
         oosc_dev_destroy(a->oosc_dev);
     midi_mode_deinit(&a->midi_mode);
 }
 
+// Queues a command for the ticker's grid, with room for glyph_count glyphs.
+static Ged_sim_cmd *ged_push_sim_cmd(Ged *a, Ged_sim_cmd_type type, Usz glyph_count)
+{
+    Ged_sim_cmds *q = &a->sim_cmds;
+    if (q->count == q->capacity) {
+        q->capacity = q->capacity ? q->capacity * 2 : 16;
+        q->cmds = realloc(q->cmds, q->capacity * sizeof(Ged_sim_cmd));
+    }
+    if (q->glyph_capacity - q->glyph_count < glyph_count) {
+        Usz capacity = q->glyph_capacity ? q->glyph_capacity : 1024;
+        while (capacity - q->glyph_count < glyph_count)
+            capacity *= 2;
+        q->glyphs = realloc(q->glyphs, capacity * sizeof(Glyph));
+        q->glyph_capacity = capacity;
+    }
+    Ged_sim_cmd *cmd = &q->cmds[q->count++];
+    cmd->type = type;
+    cmd->y = cmd->x = cmd->height = cmd->width = 0;
+    cmd->tick_num = 0;
+    cmd->glyphs_at = q->glyph_count;
+    q->glyph_count += glyph_count;
+    ++q->seq;
+    return cmd;
+}
+
+// The whole grid and tick number, in place of whatever was queued before.
+static void ged_queue_sim_field(Ged *a)
+{
+    if (!a->is_playing)
+        return;
+    Usz height = a->field.height, width = a->field.width;
+    a->sim_cmds.count = 0;
+    a->sim_cmds.glyph_count = 0;
+    Ged_sim_cmd *cmd = ged_push_sim_cmd(a, Ged_sim_cmd_field, height * width);
+    cmd->height = height;
+    cmd->width = width;
+    cmd->tick_num = a->tick_num;
+    memcpy(a->sim_cmds.glyphs + cmd->glyphs_at, a->field.buffer, height * width * sizeof(Glyph));
+}
+
+void ged_field_edited(Ged *a, Usz y, Usz x, Usz height, Usz width)
+{
+    occbuf_mark_subrect(&a->obuf_r, y, x, height, width);
+    oprog_mark_subrect(&a->prog, y, x, height, width);
+    if (!a->is_playing)
+        return;
+    Usz field_h = a->field.height, field_w = a->field.width;
+    if (y >= field_h || x >= field_w)
+        return;
+    if (height > field_h - y)
+        height = field_h - y;
+    if (width > field_w - x)
+        width = field_w - x;
+    Ged_sim_cmd *cmd = ged_push_sim_cmd(a, Ged_sim_cmd_rect, height * width);
+    cmd->y = y;
+    cmd->x = x;
+    cmd->height = height;
+    cmd->width = width;
+    gbuffer_copy_subrect(
+        a->field.buffer,
+        a->sim_cmds.glyphs + cmd->glyphs_at,
+        field_h,
+        field_w,
+        height,
+        width,
+        y,
+        x,
+        0,
+        0,
+        height,
+        width);
+}
+
+void ged_field_replaced(Ged *a)
+{
+    occbuf_invalidate(&a->obuf_r);
+    oprog_invalidate(&a->prog);
+    ged_queue_sim_field(a);
+}
+
+void ged_set_tick_num(Ged *a, Usz tick_num)
+{
+    a->tick_num = tick_num;
+    a->needs_remarking = true;
+    a->is_draw_dirty = true;
+    if (a->is_playing)
+        ged_push_sim_cmd(a, Ged_sim_cmd_tick_num, 0)->tick_num = tick_num;
+}
+
+// On the ticker's thread, with the lock held.
+static void ged_apply_sim_cmds(Ged *a)
+{
+    Ged_sim *sim = &a->sim;
+    Ged_sim_cmds *q = &a->sim_cmds;
+    for (Usz i = 0; i < q->count; ++i) {
+        Ged_sim_cmd const *cmd = &q->cmds[i];
+        Glyph *glyphs = q->glyphs + cmd->glyphs_at;
+        switch (cmd->type) {
+            case Ged_sim_cmd_rect:
+                gbuffer_copy_subrect(
+                    glyphs,
+                    sim->field.buffer,
+                    cmd->height,
+                    cmd->width,
+                    sim->field.height,
+                    sim->field.width,
+                    0,
+                    0,
+                    cmd->y,
+                    cmd->x,
+                    cmd->height,
+                    cmd->width);
+                occbuf_mark_subrect(&sim->obuf_r, cmd->y, cmd->x, cmd->height, cmd->width);
+                oprog_mark_subrect(&sim->prog, cmd->y, cmd->x, cmd->height, cmd->width);
+                break;
+            case Ged_sim_cmd_field:
+                field_resize_raw_if_necessary(&sim->field, cmd->height, cmd->width);
+                memcpy(sim->field.buffer, glyphs, cmd->height * cmd->width * sizeof(Glyph));
+                markbuf_ensure_size(&sim->mbuf_r, cmd->height, cmd->width);
+                occbuf_invalidate(&sim->obuf_r);
+                oprog_invalidate(&sim->prog);
+                sim->tick_num = cmd->tick_num;
+                break;
+            case Ged_sim_cmd_tick_num:
+                sim->tick_num = cmd->tick_num;
+                break;
+        }
+    }
+    q->count = 0;
+    q->glyph_count = 0;
+    sim->seq = q->seq;
+}
+
+static void ged_copy_sim_frame(Ged_sim *sim, Ged_frame *frame)
+{
+    Usz height = sim->field.height, width = sim->field.width;
+    field_resize_raw_if_necessary(&frame->field, height, width);
+    memcpy(frame->field.buffer, sim->field.buffer, height * width * sizeof(Glyph));
+    markbuf_ensure_size(&frame->mbuf_r, height, width);
+    memcpy(frame->mbuf_r.buffer, sim->mbuf_r.buffer, height * width * sizeof(Mark));
+    oevent_list_copy(&sim->oevent_list, &frame->oevent_list);
+    frame->tick_num = sim->tick_num;
+    frame->events_total = sim->events_total;
+    frame->seq = sim->seq;
+}
+
+bool ged_take_sim_frame(Ged *a)
+{
+    if (!a->is_frame_ready)
+        return false;
+    U8 front = a->frame_ready;
+    a->frame_ready = a->frame_front;
+    a->frame_front = front;
+    a->is_frame_ready = false;
+    Ged_frame *frame = &a->frames[front];
+    // Edits the ticker hasn't seen yet would be undone by copying this in.
+    // The next frame will have them.
+    if (frame->seq != a->sim_cmds.seq)
+        return false;
+    Usz height = frame->field.height, width = frame->field.width;
+    field_resize_raw_if_necessary(&a->field, height, width);
+    memcpy(a->field.buffer, frame->field.buffer, height * width * sizeof(Glyph));
+    markbuf_ensure_size(&a->mbuf_r, height, width);
+    memcpy(a->mbuf_r.buffer, frame->mbuf_r.buffer, height * width * sizeof(Mark));
+    mbuffer_dirty_mark_range(a->mbuf_r.dirty, 0, height * width);
+    oevent_list_copy(&frame->oevent_list, &a->oevent_list);
+    a->tick_num = frame->tick_num;
+    a->activity_counter += frame->events_total - a->frame_events_total;
+    a->frame_events_total = frame->events_total;
+    // Not ged_field_replaced(): the ticker already has this grid.
+    occbuf_invalidate(&a->obuf_r);
+    oprog_invalidate(&a->prog);
+    a->needs_remarking = true;
+    a->is_draw_dirty = true;
+    return true;
+}
+
 void clear_and_run_vm(
     Glyph *restrict gbuf,
-    Mark *restrict mbuf,
+    MarkBuf *mbr,
+    Occword *obuf,
+    Oprog *prog,
     Usz height,
     Usz width,
     Usz tick_number,
     Oevent_list *oevent_list,
     Usz random_seed)
 {
-    mbuffer_clear(mbuf, height, width);
+    markbuf_clear(mbr);
     oevent_list_clear(oevent_list);
-    orca_run(gbuf, mbuf, height, width, tick_number, oevent_list, random_seed);
+    orca_run(
+        gbuf,
+        mbr->buffer,
+        mbr->dirty,
+        obuf,
+        prog,
+        height,
+        width,
+        tick_number,
+        oevent_list,
+        random_seed,
+        NULL);
 //    test_cxx(gbuf,mbuf,height,width,tick_number);
 }
 
@@ -448,10 +519,7 @@ bool ged_is_draw_dirty(Ged *a)
 
 void ged_stop_all_sustained_notes(Ged *a)
 {
-    Susnote_list *sl = &a->susnote_list;
-    send_midi_note_offs(a->oosc_dev, &a->midi_mode, sl->buffer, sl->buffer + sl->count);
-    susnote_list_clear(sl);
-    a->time_to_next_note_off = 1.0;
+    play_stop_all_sustained_notes(a->oosc_dev, &a->midi_mode, &a->susnotes);
 }
 
 void ged_clear_osc_udp(Ged *a)
@@ -473,116 +541,101 @@ bool ged_is_using_osc_udp(Ged *a)
 bool ged_set_osc_udp(Ged *a, char const *dest_addr, char const *dest_port)
 {
     ged_clear_osc_udp(a);
-    if (dest_port) {
-        Oosc_udp_create_error err = oosc_dev_create_udp(&a->oosc_dev, dest_addr, dest_port);
-        if (err) {
-            return false;
-        }
+    if (!dest_port && !a->osc_dest_count)
+        return true;
+    a->oosc_dev = oosc_dev_create();
+    Oosc_dest dest = { .addr = dest_addr, .port = dest_port, .kinds = Oosc_kinds_all };
+    bool ok = !dest_port || !oosc_dev_add_udp(a->oosc_dev, &dest);
+    for (Usz i = 0; ok && i < a->osc_dest_count; ++i)
+        ok = !oosc_dev_add_udp(a->oosc_dev, &a->osc_dests[i]);
+    if (!ok) {
+        oosc_dev_destroy(a->oosc_dev);
+        a->oosc_dev = NULL;
+        return false;
     }
+    oosc_dev_set_bundling(a->oosc_dev, a->is_osc_bundling);
     return true;
 }
 
-double ged_secs_to_deadline(Ged const *a)
+bool ged_step_due(Ged const *a, U64 *due)
 {
     if (!a->is_playing)
-        return 1.0;
-    double secs_span = 60.0 / (double)a->bpm / 4.0;
-    // If MIDI beat clock output is enabled, we need to send an event every 24
-    // parts per quarter note. Since we've already divided quarter notes into 4
-    // for ORCA's timing semantics, divide it by a further 6. This same logic is
-    // mirrored in ged_do_stuff().
-    if (a->midi_bclock)
-        secs_span /= 6.0;
-    double rem = secs_span - (stm_sec(stm_since(a->clock)) + a->accum_secs);
-    double next_note_off = a->time_to_next_note_off;
-    if (next_note_off < rem)
-        rem = next_note_off;
-    if (rem < 0.0)
-        rem = 0.0;
-    return rem;
+        return false;
+    *due = play_clock_step_due(&a->play_clock, a->bpm, a->midi_bclock);
+    return true;
 }
 
-void ged_do_stuff(Ged *a)
+static void ged_publish_tick(
+    Net_shm *shm, Field const *field, MarkBuf const *mbr, Usz tick_num, Oevent_list const *ol)
+{
+    net_shm_publish(
+        shm,
+        field->buffer,
+        mbr->buffer,
+        field->height,
+        field->width,
+        tick_num,
+        ol->buffer,
+        ol->size,
+        ol->count);
+}
+
+bool ged_do_stuff(Ged *a)
 {
     if (!a->is_playing)
-        return;
-    double secs_span = 60.0 / (double)a->bpm / 4.0;
-    if (a->midi_bclock) // see also ged_secs_to_deadline()
-        secs_span /= 6.0;
+        return false;
     Oosc_dev *oosc_dev = a->oosc_dev;
     Midi_mode *midi_mode = &a->midi_mode;
-    bool crossed_deadline = false;
-#if TIME_DEBUG
-    Usz spins = 0;
-    U64 spin_start = stm_now();
-    (void)spin_start;
-#endif
-    for (;;) {
-        U64 now = stm_now();
-        U64 diff = stm_diff(now, a->clock);
-        double sdiff = stm_sec(diff) + a->accum_secs;
-        if (sdiff >= secs_span) {
-            a->clock = now;
-            a->accum_secs = sdiff - secs_span;
-#if TIME_DEBUG
-            if (a->accum_secs > 0.000001) {
-                fprintf(stderr, "late: %.2f u-secs\n", a->accum_secs * 1000 * 1000);
-                if (a->accum_secs > 0.00005) {
-                    fprintf(stderr, "guilty timeout: %d\n", spin_track_timeout);
-                }
-            }
-#endif
-            crossed_deadline = true;
-            break;
-        }
-        if (secs_span - sdiff > ms_to_sec(0.1))
-            break;
-#if TIME_DEBUG
-        ++spins;
-#endif
-    }
-#if TIME_DEBUG
-    if (spins > 0) {
-        fprintf(
-            stderr,
-            "%d spins in %f us with timeout %d\n",
-            (int)spins,
-            stm_us(stm_since(spin_start)),
-            spin_track_timeout);
-    }
+    if (!play_clock_step(
+            &a->play_clock,
+            a->bpm,
+            a->midi_bclock,
+            a->lookahead_ms,
+            oosc_dev,
+            midi_mode,
+            &a->susnotes))
+        return false;
+    Ged_sim *sim = &a->sim;
+    ged_apply_sim_cmds(a);
+    Usz random_seed = a->random_seed;
+    Ged_frame *frame = &a->frames[a->frame_back];
+    // Nothing below touches what the UI does, until the lock is held again.
+    if (a->ticker)
+        play_ticker_unlock(a->ticker);
+#ifdef FEAT_PROFILE
+    orca_profile_into(&sim->prof);
 #endif
-    if (!crossed_deadline)
-        return;
-    if (a->midi_bclock) {
-        send_midi_byte(oosc_dev, midi_mode, 0xF8); // MIDI beat clock
-        Usz sixths = a->midi_bclock_sixths;
-        a->midi_bclock_sixths = (U8)((sixths + 1) % 6);
-        if (sixths != 0)
-            return;
-    }
-    apply_time_to_sustained_notes(
-        oosc_dev,
-        midi_mode,
-        secs_span,
-        &a->susnote_list,
-        &a->time_to_next_note_off);
     clear_and_run_vm(
-        a->field.buffer,
-        a->mbuf_r.buffer,
-        a->field.height,
-        a->field.width,
-        a->tick_num,
-        &a->oevent_list,
-        a->random_seed);
-    ++a->tick_num;
-    a->needs_remarking = true;
-    a->is_draw_dirty = true;
+        sim->field.buffer,
+        &sim->mbuf_r,
+        occbuf_sync(&sim->obuf_r, &sim->field),
+        &sim->prog,
+        sim->field.height,
+        sim->field.width,
+        sim->tick_num,
+        &sim->oevent_list,
+        random_seed);
+    if (a->net_shm)
+        ged_publish_tick(a->net_shm, &sim->field, &sim->mbuf_r, sim->tick_num, &sim->oevent_list);
+    ++sim->tick_num;
+    sim->events_total += sim->oevent_list.count;
+    ged_copy_sim_frame(sim, frame);
+    if (a->ticker)
+        play_ticker_lock(a->ticker);
+#ifdef FEAT_PROFILE
+    orca_profile_collect(&sim->prof);
+#endif
+    a->frame_back = a->frame_ready;
+    a->frame_ready = (U8)(frame - a->frames);
+    a->is_frame_ready = true;
 
-    Usz count = a->oevent_list.count;
-    if (count > 0) {
-        send_output_events(oosc_dev, midi_mode, a->bpm, &a->susnote_list, a->oevent_list.buffer, count);
-        a->activity_counter += count;
+    // If it was paused in the meantime, the tick doesn't count.
+    if (a->is_playing && sim->oevent_list.count > 0) {
+        play_clock_output_at_step(&a->play_clock, a->lookahead_ms, a->oosc_dev, &a->midi_mode);
+        send_output_events(a->oosc_dev, &a->midi_mode, &a->susnotes, &sim->oevent_list);
+        play_output_now(a->oosc_dev, &a->midi_mode);
     }
+    return true;
 }
 
 Isz isz_clamp(Isz x, Isz low, Isz high)
@@ -681,12 +734,13 @@ void draw_oevent_list(WINDOW *win, Oevent_list const *oevent_list)
     wmove(win, 0, 0);
     int win_h = getmaxy(win);
     wprintw(win, "Count: %d", (int)oevent_list->count);
-    for (Usz i = 0, num_events = oevent_list->count; i < num_events; ++i) {
+    for (Oevent const *ev = oevent_list_begin(oevent_list), *end = oevent_list_end(oevent_list);
+         ev != end;
+         ev = oevent_next(ev)) {
         int cury = getcury(win);
         if (cury + 1 >= win_h)
             return;
         wmove(win, cury + 1, 0);
-        Oevent const *ev = oevent_list->buffer + i;
         Oevent_types evt = ev->any.oevent_type;
         switch (evt) {
             case Oevent_type_midi_note: {
@@ -745,6 +799,7 @@ void draw_oevent_list(WINDOW *win, Oevent_list const *oevent_list)
 void ged_resize_grid(
     Field *field,
     MarkBuf *mbr,
+    OccBuf *obr,
     Usz new_height,
     Usz new_width,
     Usz tick_num,
@@ -773,6 +828,7 @@ void ged_resize_grid(
         scratch_field->width);
     ged_cursor_confine(ged_cursor, new_height, new_width);
     markbuf_ensure_size(mbr, new_height, new_width);
+    occbuf_invalidate(obr);
 }
 
 void draw_grid_cursor(
@@ -1122,9 +1178,14 @@ void ged_draw(Ged *a, WINDOW *win, char const *filename, bool use_fancy_dots, bo
         field_resize_raw_if_necessary(&a->scratch_field, a->field.height, a->field.width);
         field_copy(&a->field, &a->scratch_field);
         markbuf_ensure_size(&a->mbuf_r, a->field.height, a->field.width);
+        // The occupancy bitmaps and compiled program belong to the real
+        // field, and the VM would update them for changes it makes to the
+        // scratch copy, so this run scans every cell instead.
         clear_and_run_vm(
             a->scratch_field.buffer,
-            a->mbuf_r.buffer,
+            &a->mbuf_r,
+            NULL,
+            NULL,
             a->field.height,
             a->field.width,
             a->tick_num,
@@ -1312,6 +1373,12 @@ bool ged_slide_selection(Ged *a, int delta_y, int delta_x)
     }
     gbuffer_fill_subrect(a->field.buffer, field_h, field_w, ey, curs_x_0, eh, curs_w_0, '.');
     gbuffer_fill_subrect(a->field.buffer, field_h, field_w, curs_y_0, ex, curs_h_0, ew, '.');
+    // Both where it went and what it left behind.
+    Usz uy = curs_y_1 < curs_y_0 ? curs_y_1 : curs_y_0;
+    Usz ux = curs_x_1 < curs_x_0 ? curs_x_1 : curs_x_0;
+    Usz uh = curs_h_0 + (curs_y_1 < curs_y_0 ? curs_y_0 - curs_y_1 : curs_y_1 - curs_y_0);
+    Usz uw = curs_w_0 + (curs_x_1 < curs_x_0 ? curs_x_0 - curs_x_1 : curs_x_1 - curs_x_0);
+    ged_field_edited(a, uy, ux, uh, uw);
     a->needs_remarking = true;
     return true;
 }
@@ -1500,6 +1567,7 @@ Usz adjust_rulers_humanized(Usz ruler, Usz in, Isz delta_rulers)
 bool ged_resize_grid_snap_ruler(
     Field *field,
     MarkBuf *mbr,
+    OccBuf *obr,
     Usz ruler_y,
     Usz ruler_x,
     Isz delta_h,
@@ -1529,15 +1597,16 @@ bool ged_resize_grid_snap_ruler(
         new_field_w = ORCA_X_MAX;
     if (new_field_h == field_h && new_field_w == field_w)
         return false;
-    ged_resize_grid(field, mbr, new_field_h, new_field_w, tick_num, scratch_field, undo_hist, ged_cursor);
+    ged_resize_grid(field, mbr, obr, new_field_h, new_field_w, tick_num, scratch_field, undo_hist, ged_cursor);
     return true;
 }
 
 void ged_resize_grid_relative(Ged *a, Isz delta_y, Isz delta_x)
 {
-    ged_resize_grid_snap_ruler(
+    bool resized = ged_resize_grid_snap_ruler(
         &a->field,
         &a->mbuf_r,
+        &a->obuf_r,
         a->ruler_spacing_y,
         a->ruler_spacing_x,
         delta_y,
@@ -1546,6 +1615,8 @@ void ged_resize_grid_relative(Ged *a, Isz delta_y, Isz delta_x)
         &a->scratch_field,
         &a->undo_hist,
         &a->ged_cursor);
+    if (resized)
+        ged_field_replaced(a);
     a->needs_remarking = true; // could check if we actually resized
     a->is_draw_dirty = true;
     ged_update_internal_geometry(a);
@@ -1556,6 +1627,7 @@ void ged_write_character(Ged *a, char c)
 {
     undo_history_push(&a->undo_hist, &a->field, a->tick_num);
     gbuffer_poke(a->field.buffer, a->field.height, a->field.width, a->ged_cursor.y, a->ged_cursor.x, c);
+    ged_field_edited(a, a->ged_cursor.y, a->ged_cursor.x, 1, 1);
     // Indicate we want the next simulation step to be run predictavely,
     // so that we can use the reulsting mark buffer for UI visualization.
     // This is "expensive", so it could be skipped for non-interactive
@@ -1581,6 +1653,7 @@ bool ged_fill_selection_with_char(Ged *a, Glyph c)
         curs_h,
         curs_w,
         c);
+    ged_field_edited(a, curs_y, curs_x, curs_h, curs_w);
     return true;
 }
 
@@ -1637,22 +1710,17 @@ void ged_set_playing(Ged *a, bool playing)
     if (playing) {
         undo_history_push(&a->undo_hist, &a->field, a->tick_num);
         a->is_playing = true;
-        a->clock = stm_now();
-        a->midi_bclock_sixths = 0;
-        // dumb'n'dirty, get us close to the next step time, but not quite
-        a->accum_secs = 60.0 / (double)a->bpm / 4.0;
-        if (a->midi_bclock) {
-            send_midi_byte(a->oosc_dev, &a->midi_mode, 0xFA); // "start"
-            a->accum_secs /= 6.0;
-        }
-        a->accum_secs -= 0.0001;
-        send_control_message(a->oosc_dev, "/orca/started");
+        ged_queue_sim_field(a);
+        play_clock_start(&a->play_clock, a->bpm, a->midi_bclock, a->oosc_dev, &a->midi_mode);
+        if (a->ticker)
+            play_ticker_poke(a->ticker);
     } else {
-        ged_stop_all_sustained_notes(a);
+        play_clock_stop(a->midi_bclock, a->oosc_dev, &a->midi_mode, &a->susnotes);
         a->is_playing = false;
-        send_control_message(a->oosc_dev, "/orca/stopped");
-        if (a->midi_bclock)
-            send_midi_byte(a->oosc_dev, &a->midi_mode, 0xFC); // "stop"
+        // Keep the last tick whose events went out, and drop the one the
+        // ticker might be running now.
+        ged_take_sim_frame(a);
+        ++a->sim_cmds.seq;
     }
     a->is_draw_dirty = true;
 }
@@ -1667,6 +1735,7 @@ void ged_input_cmd(Ged *a, Ged_input_cmd ev)
                 undo_history_apply(&a->undo_hist, &a->field, &a->tick_num);
             else
                 undo_history_pop(&a->undo_hist, &a->field, &a->tick_num);
+            ged_field_replaced(a);
             ged_cursor_confine(&a->ged_cursor, a->field.height, a->field.width);
             ged_update_internal_geometry(a);
             ged_make_cursor_visible(a);
@@ -1692,14 +1761,19 @@ void ged_input_cmd(Ged *a, Ged_input_cmd ev)
             undo_history_push(&a->undo_hist, &a->field, a->tick_num);
             clear_and_run_vm(
                 a->field.buffer,
-                a->mbuf_r.buffer,
+                &a->mbuf_r,
+                occbuf_sync(&a->obuf_r, &a->field),
+                &a->prog,
                 a->field.height,
                 a->field.width,
                 a->tick_num,
                 &a->oevent_list,
                 a->random_seed);
+            if (a->net_shm)
+                ged_publish_tick(a->net_shm, &a->field, &a->mbuf_r, a->tick_num, &a->oevent_list);
             ++a->tick_num;
             a->activity_counter += a->oevent_list.count;
+            ged_queue_sim_field(a);
             a->needs_remarking = true;
             a->is_draw_dirty = true;
             break;
@@ -1753,6 +1827,7 @@ void ged_input_cmd(Ged *a, Ged_input_cmd ev)
                 curs_x,
                 cpy_h,
                 cpy_w);
+            ged_field_edited(a, curs_y, curs_x, cpy_h, cpy_w);
             a->ged_cursor.h = cpy_h;
             a->ged_cursor.w = cpy_w;
             a->needs_remarking = true;
@@ -1,9 +1,12 @@
 #pragma once
 #include "field.h"
+#include "sim.h"
 #include "vmio.h"
 #include "term_util.h"
 #include "midi.h"
 #include "osc_out.h"
+#include "player.h"
+#include "net.h"
 
 typedef enum
 {
@@ -20,25 +23,93 @@ typedef struct {
     Usz w;
 } Ged_cursor;
 
+// While playing, the ticker's thread runs the VM on a grid of its own
+// (Ged_sim), so the UI never waits for a tick, and a tick never waits for the
+// UI. What the UI does to its grid goes to the ticker as commands, queued by
+// ged_field_edited() and friends and applied before the next tick. Each tick
+// comes back as a Ged_frame through a triple buffer, and ged_take_sim_frame()
+// copies the newest one in for drawing.
+typedef enum
+{
+    Ged_sim_cmd_rect,     // Copy in a rectangle of the UI's grid
+    Ged_sim_cmd_field,    // Copy in all of it, and the tick number
+    Ged_sim_cmd_tick_num, // Set the tick number
+} Ged_sim_cmd_type;
+
+typedef struct {
+    Ged_sim_cmd_type type;
+    Usz y, x, height, width;
+    Usz tick_num;
+    Usz glyphs_at; // Where its glyphs start in Ged_sim_cmds.glyphs
+} Ged_sim_cmd;
+
+// Only touched with the ticker's lock held.
+typedef struct {
+    Ged_sim_cmd *cmds;
+    Glyph *glyphs;
+    Usz count, capacity;
+    Usz glyph_count, glyph_capacity;
+    U64 seq; // Bumped by each command, and when frames on the way become stale
+} Ged_sim_cmds;
+
+// Only touched by the ticker's thread.
+typedef struct {
+    Field field;
+    MarkBuf mbuf_r;
+    OccBuf obuf_r;
+    Oprog prog;
+    Oevent_list oevent_list;
+    Usz tick_num;
+    Usz events_total; // Events from every tick so far, for the activity indicator
+    U64 seq;          // Of the last command applied
+#ifdef FEAT_PROFILE
+    Oprof prof; // Counts from the tick being run, added to the totals with the lock held
+#endif
+} Ged_sim;
+
+typedef struct {
+    Field field;
+    MarkBuf mbuf_r;
+    Oevent_list oevent_list;
+    Usz tick_num;
+    Usz events_total;
+    U64 seq;
+} Ged_frame;
+
 typedef struct {
     Field field;
     Field scratch_field;
     Field clipboard_field;
     MarkBuf mbuf_r;
+    OccBuf obuf_r;
+    Oprog prog;
     Undo_history undo_hist;
     Oevent_list oevent_list;
     Oevent_list scratch_oevent_list;
-    Susnote_list susnote_list;
+    Susnote_table susnotes;
     Ged_cursor ged_cursor;
     Usz tick_num;
     Usz ruler_spacing_y;
     Usz ruler_spacing_x;
     Ged_input_mode input_mode;
     Usz bpm;
-    U64 clock;
-    double accum_secs;
-    double time_to_next_note_off;
+    Usz lookahead_ms; // See player.h
+    Play_clock play_clock;
+    Play_ticker *ticker; // If set, it calls ged_do_stuff(), and owns the lock on all of this
+    Ged_sim sim;
+    Ged_sim_cmds sim_cmds;
+    // The ticker fills frames[frame_back], the UI reads frames[frame_front],
+    // and they trade with frame_ready, under the lock.
+    Ged_frame frames[3];
+    U8 frame_back, frame_ready, frame_front;
+    bool is_frame_ready;
+    Usz frame_events_total; // events_total of the last frame taken
     Oosc_dev *oosc_dev;
+    // More destinations for OSC output, next to the one from the menu, while
+    // it's on. Not owned.
+    Oosc_dest const *osc_dests;
+    Usz osc_dest_count;
+    Net_shm *net_shm; // If set, each tick gets published to it. Not owned.
     Midi_mode midi_mode;
     Usz activity_counter;
     Usz random_seed;
@@ -50,16 +121,17 @@ typedef struct {
     int softmargin_x;
     int grid_h;
     int grid_scroll_y;
-    int grid_scroll_x;     // not sure if i like this being int
-    U8 midi_bclock_sixths; // 0..5, holds 6th of the quarter note step
+    int grid_scroll_x; // not sure if i like this being int
+    // Not bit-fields: the ticker reads these while the UI writes the others.
+    bool is_playing;
+    bool midi_bclock;
     bool needs_remarking : 1;
     bool is_draw_dirty : 1;
-    bool is_playing : 1;
-    bool midi_bclock : 1;
     bool draw_event_list : 1;
     bool is_mouse_down : 1;
     bool is_mouse_dragging : 1;
     bool is_hud_visible : 1;
+    bool is_osc_bundling : 1; // Each tick's OSC in one bundle (see oosc_dev_set_bundling())
 } Ged;
 
 typedef enum
@@ -94,13 +166,24 @@ void ged_send_osc_bpm(Ged *a, I32 bpm);
 
 void ged_set_playing(Ged *a, bool playing);
 
-void ged_do_stuff(Ged *a);
+// Runs a tick if one is due, and returns whether it did. Called by the
+// ticker with its lock held, which it lets go of while the VM runs.
+bool ged_do_stuff(Ged *a);
+
+// If the ticker has finished a tick since the last call, and it saw every
+// edit made since, copy its grid, marks and events in to draw. Call with the
+// ticker's lock held. Returns whether there was one.
+bool ged_take_sim_frame(Ged *a);
+
+void ged_set_tick_num(Ged *a, Usz tick_num);
 
 bool ged_is_draw_dirty(Ged *a);
 
 void ged_draw(Ged *a, WINDOW *win, char const *filename, bool use_fancy_dots, bool use_fancy_rulers);
 
-double ged_secs_to_deadline(Ged const *a);
+// If playing, sets due to when ged_do_stuff() has a tick to run, in stm_now()
+// ticks, and returns true.
+bool ged_step_due(Ged const *a, U64 *due);
 
 ORCA_OK_IF_UNUSED void ged_mouse_event(Ged *a, Usz vis_y, Usz vis_x, mmask_t mouse_bstate);
 
@@ -111,9 +194,18 @@ void ged_input_character(Ged *a, char c);
 
 void ged_set_window_size(Ged *a, int win_h, int win_w, int softmargin_y, int softmargin_x);
 
+// Code that changes the field in place, outside of the VM, reports what it
+// touched here, so the VM's occupancy bitmaps and compiled program see it,
+// and so does the ticker's copy of the grid while playing. Code that replaces
+// or resizes the field wholesale calls ged_field_replaced() instead.
+void ged_field_edited(Ged *a, Usz y, Usz x, Usz height, Usz width);
+
+void ged_field_replaced(Ged *a);
+
 void ged_resize_grid(
     Field *field,
     MarkBuf *mbr,
+    OccBuf *obr,
     Usz new_height,
     Usz new_width,
     Usz tick_num,
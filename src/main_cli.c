@@ -1,7 +1,10 @@
 #include "base.h"
 #include "field.h"
 #include "gbuffer.h"
+#include "output.h"
 #include "sim.h"
+#include "smf.h"
+#include "trace.h"
 #include "vmio.h"
 #include <getopt.h>
 
@@ -17,22 +20,380 @@ fprintf(stderr,
 "    -t <number>   Number of timesteps to simulate.\n"
 "                  Must be 0 or a positive integer.\n"
 "                  Default: 1\n"
+"    -j <number>   Number of threads to run each timestep on.\n"
+"                  Default: 1\n"
 "    -q or --quiet Don't print the result to stdout.\n"
 "    -h or --help  Print this message and exit.\n"
+"    --fast-forward\n"
+"                  Look for the grid repeating, and once it does, skip\n"
+"                  ahead by whole periods. Prints the period to stderr.\n"
+"                  Doesn't work with --smf, --events or --frames.\n"
+"    --profile     Print how often each operator ran and how long it\n"
+"                  took to stderr at the end. Needs a build with\n"
+"                  PROFILE_ENABLED=1.\n"
+"    --check-parallel\n"
+"                  Also run each timestep on a copy of the grid with the\n"
+"                  serial VM, and stop with an error at the first one\n"
+"                  where the grid, marks or events differ.\n"
+"    --chunked     Store the grid in chunks, and only the ones that aren't\n"
+"                  empty. Allows grids bigger than 65535 on a side.\n"
+"    --canvas <wxh>\n"
+"                  Run on a canvas of this size instead, with the file in\n"
+"                  its top left corner. Implies --chunked.\n"
+"    --smf <file>  Write the MIDI the timesteps send to a Standard MIDI\n"
+"                  File (type 1, a track per channel), timed as if\n"
+"                  played at --bpm. Notes are held and ended like in\n"
+"                  orca, and the ones still on at the end are ended\n"
+"                  there.\n"
+"    --bpm <number>\n"
+"                  Tempo for --smf, from 4 up.\n"
+"                  Default: 120\n"
+"    --events <file>\n"
+"                  Write the events of each timestep to the file as they\n"
+"                  happen, one JSON object per line. - is stdout.\n"
+"    --frames <file>\n"
+"                  Write the grid to the file, and then after each\n"
+"                  timestep the cells that changed in it, one JSON object\n"
+"                  per line. - is stdout. Doesn't work with --chunked.\n"
 );} // clang-format on
 
+// Returns what differs between the two runs of a tick, or NULL if nothing.
+static char const *diff_runs(
+    Field const *field,
+    Mark const *mbuf,
+    Oevent_list const *oevent_list,
+    Field const *check_field,
+    Mark const *check_mbuf,
+    Oevent_list const *check_oevent_list)
+{
+    Usz count = (Usz)field->height * field->width;
+    if (memcmp(field->buffer, check_field->buffer, count * sizeof(Glyph)))
+        return "grid";
+    if (memcmp(mbuf, check_mbuf, count * sizeof(Mark)))
+        return "marks";
+    if (oevent_list->count != check_oevent_list->count)
+        return "event count";
+    if (oevent_list->size != check_oevent_list->size ||
+        memcmp(oevent_list->buffer, check_oevent_list->buffer, oevent_list->size))
+        return "events";
+    return NULL;
+}
+
+// --smf: the MIDI the ticks' events send, the same way as in playback (see
+// send_output_events() in player.h), kept with the tick it went out on.
+typedef struct {
+    Smf smf;
+    Susnote_table susnotes;
+    Usz tick;
+    FILE *file;
+    Usz bpm;
+} Smf_render;
+
+static void smf_render_midi(void *userdata, U8 status, U8 byte1, U8 byte2)
+{
+    Smf_render *r = userdata;
+    smf_add(&r->smf, r->tick, status, byte1, byte2);
+}
+
+static void smf_render_osc_ints(void *userdata, char const *osc_address, I32 const *vals, Usz count)
+{
+    (void)userdata;
+    (void)osc_address;
+    (void)vals;
+    (void)count;
+}
+
+static void smf_render_datagram(void *userdata, char const *data, Usz size)
+{
+    (void)userdata;
+    (void)data;
+    (void)size;
+}
+
+static void smf_render_note_offs(Smf_render *r, Usz count)
+{
+    for (Usz i = 0; i < count; ++i) {
+        U16 note = r->susnotes.offs[i];
+        smf_add(&r->smf, r->tick, (U8)(0x80 | note >> 7), (U8)(note & 0x7F), 0);
+    }
+}
+
+// Call with every tick's events, from tick 0 on. Like in playback, a tick
+// passes for the sustained notes before the tick's own events.
+static void smf_render_tick(Smf_render *r, Usz tick, Oevent_list const *oevent_list)
+{
+    r->tick = tick;
+    smf_render_note_offs(r, susnote_table_advance(&r->susnotes));
+    Output_sink sink = {
+        .midi = smf_render_midi,
+        .osc_ints = smf_render_osc_ints,
+        .datagram = smf_render_datagram,
+        .userdata = r,
+    };
+    output_events(&sink, &r->susnotes, oevent_list);
+}
+
+// Where a run streams to as it goes, besides the grid printed at the end.
+// The ones that weren't asked for are NULL.
+typedef struct {
+    Smf_render *smf_render;
+    Trace *events, *frames;
+    char const *smf_file, *events_file, *frames_file;
+} Run_outputs;
+
+// "-" is stdout.
+static FILE *open_output(char const *file_name)
+{
+    if (strcmp(file_name, "-") == 0)
+        return stdout;
+    FILE *file = fopen(file_name, "wb");
+    if (!file)
+        fprintf(stderr, "Couldn't open %s for writing.\n", file_name);
+    return file;
+}
+
+// Returns the result, or 1 if writing to the file failed.
+static int close_output(FILE *file, char const *file_name, bool ok, int result)
+{
+    ok = ok && !ferror(file);
+    if (file == stdout ? fflush(file) : fclose(file))
+        ok = false;
+    if (!ok) {
+        fprintf(stderr, "Couldn't write %s.\n", file_name);
+        result = 1;
+    }
+    return result;
+}
+
+// Call after each tick, with its events and the grid it left.
+static void run_outputs_tick(
+    Run_outputs const *ro,
+    Usz tick,
+    Oevent_list const *oevent_list,
+    Glyph const *gbuffer)
+{
+    if (ro->smf_render)
+        smf_render_tick(ro->smf_render, tick, oevent_list);
+    if (ro->events)
+        trace_events(ro->events, tick, oevent_list);
+    if (ro->frames)
+        trace_frame(ro->frames, tick, gbuffer);
+}
+
+// End the notes still on at end_tick, write the MIDI file if the run went
+// well (and remove it if not), and close everything. Returns the run's
+// result, or 1 if writing failed.
+static int run_outputs_end(Run_outputs *ro, Usz end_tick, int result)
+{
+    Smf_render *r = ro->smf_render;
+    if (r) {
+        r->tick = end_tick;
+        smf_render_note_offs(r, susnote_table_remove_all(&r->susnotes));
+        bool ok = result != 0 || smf_write(&r->smf, r->file, r->bpm, end_tick);
+        result = close_output(r->file, ro->smf_file, ok, result);
+        if (result != 0 && r->file != stdout)
+            remove(ro->smf_file);
+        smf_deinit(&r->smf);
+        free(r);
+    }
+    if (ro->events) {
+        result = close_output(ro->events->file, ro->events_file, true, result);
+        trace_deinit(ro->events);
+    }
+    if (ro->frames) {
+        result = close_output(ro->frames->file, ro->frames_file, true, result);
+        trace_deinit(ro->frames);
+    }
+    return result;
+}
+
+// --chunked: the same run, on a Cfield instead of a Field.
+static int run_chunked(
+    char const *input_file,
+    Usz ticks,
+    Usz canvas_height,
+    Usz canvas_width,
+    bool print_output,
+    Run_outputs const *outputs)
+{
+    Cfield cfield;
+    cfield_init(&cfield);
+    Field_load_error fle = cfield_load_file(input_file, &cfield);
+    if (fle != Field_load_error_ok) {
+        cfield_deinit(&cfield);
+        fprintf(stderr, "File load error: %s.\n", field_load_error_string(fle));
+        return 1;
+    }
+    if (canvas_height) {
+        if (canvas_height < cfield.height || canvas_width < cfield.width) {
+            fprintf(
+                stderr,
+                "Canvas %zux%zu is smaller than the %zux%zu grid in the file.\n",
+                canvas_width,
+                canvas_height,
+                cfield.width,
+                cfield.height);
+            cfield_deinit(&cfield);
+            return 1;
+        }
+        cfield_resize(&cfield, canvas_height, canvas_width);
+    }
+    Oislands *islands = oislands_create();
+    Oevent_list oevent_list;
+    oevent_list_init(&oevent_list);
+    for (Usz i = 0; i < ticks; ++i) {
+        oevent_list_clear(&oevent_list);
+        orca_run_cfield(islands, &cfield, i, &oevent_list, 0, NULL);
+        run_outputs_tick(outputs, i, &oevent_list, NULL);
+    }
+    oislands_destroy(islands);
+    oevent_list_deinit(&oevent_list);
+    if (print_output)
+        cfield_fput(&cfield, stdout);
+    cfield_deinit(&cfield);
+    return 0;
+}
+
+#ifdef FEAT_PROFILE
+static void print_profile(FILE *stream)
+{
+    Oprof const *prof = orca_profile();
+    Glyph glyphs[ORCA_ARRAY_COUNTOF(prof->glyphs)];
+    Usz count = orca_profile_sorted(prof, glyphs);
+    fprintf(stream, "Op %12s %12s %14s %10s\n", "Calls", "Early exits", "Time", "Time/call");
+    for (Usz i = 0; i < count; ++i) {
+        Oprof_glyph const *pg = prof->glyphs + (U8)glyphs[i];
+        fprintf(
+            stream,
+            "%c  %12llu %12llu %14llu %10.1f\n",
+            glyphs[i],
+            (unsigned long long)pg->calls,
+            (unsigned long long)pg->early_exits,
+            (unsigned long long)pg->time,
+            (double)pg->time / (double)pg->calls);
+    }
+}
+#endif
+
+// Looks for the grid repeating with Brent's algorithm: keep a copy of the
+// grid from some timestep, compare each later grid against it, and move the
+// copy up to the current timestep whenever the number of timesteps since it
+// reaches the next power of two. Comparing whole grids rather than hashes
+// means a match is never wrong, and only one copy is ever kept.
+//
+// Equal grids aren't enough by themselves, the VM also looks at the timestep
+// number. So the periods the timesteps since the copy depended on are kept
+// too (see Otick_deps), and a repeat only counts once the distance to the
+// copy is a multiple of all of them.
+typedef struct {
+    Field saved;
+    Usz saved_tick; // The grid in saved is from just before this timestep
+    Usz window; // Where saved moves up next, in timesteps since saved_tick
+    Usz lcm; // Of the periods depended on since saved_tick, 0 if hopeless
+} Cycle_finder;
+
+enum
+{
+    Cycle_finder_lcm_max = 1 << 30,
+};
+
+static void cycle_finder_init(Cycle_finder *cf, Field *field)
+{
+    field_init(&cf->saved);
+    field_copy(field, &cf->saved);
+    cf->saved_tick = 0;
+    cf->window = 1;
+    cf->lcm = 1;
+}
+
+static void cycle_finder_deinit(Cycle_finder *cf)
+{
+    field_deinit(&cf->saved);
+}
+
+static Usz gcd(Usz a, Usz b)
+{
+    while (b) {
+        Usz t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Call after running each timestep, with the grid it left and what it did
+// with its timestep number. Returns the period if the grid from here on will
+// be the same as it was that many timesteps ago, or 0.
+static Usz cycle_finder_step(Cycle_finder *cf, Field *field, Usz tick, Otick_deps const *deps)
+{
+    if (deps->aperiodic)
+        cf->lcm = 0;
+    for (Usz i = 0; i < ORCA_ARRAY_COUNTOF(deps->periods) && cf->lcm; ++i) {
+        for (U64 bits = deps->periods[i]; bits && cf->lcm; bits &= bits - 1) {
+            Usz period = i * 64 + (Usz)__builtin_ctzll(bits);
+            cf->lcm = cf->lcm / gcd(cf->lcm, period) * period;
+            if (cf->lcm > Cycle_finder_lcm_max)
+                cf->lcm = 0;
+        }
+    }
+    Usz distance = tick + 1 - cf->saved_tick;
+    if (cf->lcm && distance % cf->lcm == 0 &&
+        !memcmp(field->buffer, cf->saved.buffer, (Usz)field->height * field->width * sizeof(Glyph)))
+        return distance;
+    if (distance == cf->window) {
+        field_copy(field, &cf->saved);
+        cf->saved_tick = tick + 1;
+        cf->window *= 2;
+        cf->lcm = 1;
+    }
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
-    static struct option cli_options[] = { { "help", no_argument, 0, 'h' },
-                                           { "quiet", no_argument, 0, 'q' },
-                                           { NULL, 0, NULL, 0 } };
+    enum
+    {
+        Argopt_check_parallel = UCHAR_MAX + 1,
+        Argopt_fast_forward,
+        Argopt_profile,
+        Argopt_chunked,
+        Argopt_canvas,
+        Argopt_smf,
+        Argopt_bpm,
+        Argopt_events,
+        Argopt_frames,
+    };
+    static struct option cli_options[] = {
+        { "help", no_argument, 0, 'h' },
+        { "quiet", no_argument, 0, 'q' },
+        { "check-parallel", no_argument, 0, Argopt_check_parallel },
+        { "fast-forward", no_argument, 0, Argopt_fast_forward },
+        { "profile", no_argument, 0, Argopt_profile },
+        { "chunked", no_argument, 0, Argopt_chunked },
+        { "canvas", required_argument, 0, Argopt_canvas },
+        { "smf", required_argument, 0, Argopt_smf },
+        { "bpm", required_argument, 0, Argopt_bpm },
+        { "events", required_argument, 0, Argopt_events },
+        { "frames", required_argument, 0, Argopt_frames },
+        { NULL, 0, NULL, 0 }
+    };
 
     char *input_file = NULL;
     int ticks = 1;
+    int threads = 1;
     bool print_output = true;
+    bool check_parallel = false;
+    bool fast_forward = false;
+    bool profile = false;
+    bool chunked = false;
+    Usz canvas_height = 0, canvas_width = 0;
+    char const *smf_file = NULL;
+    char const *events_file = NULL;
+    char const *frames_file = NULL;
+    int bpm = 120;
 
     for (;;) {
-        int c = getopt_long(argc, argv, "t:qh", cli_options, NULL);
+        int c = getopt_long(argc, argv, "t:j:qh", cli_options, NULL);
         if (c == -1)
             break;
         switch (c) {
@@ -47,9 +408,69 @@ int main(int argc, char **argv)
                     return 1;
                 }
                 break;
+            case 'j':
+                threads = atoi(optarg);
+                if (threads < 1) {
+                    fprintf(
+                        stderr,
+                        "Bad thread count argument %s.\n"
+                        "Must be a positive integer.\n",
+                        optarg);
+                    return 1;
+                }
+                break;
             case 'q':
                 print_output = false;
                 break;
+            case Argopt_check_parallel:
+                check_parallel = true;
+                break;
+            case Argopt_fast_forward:
+                fast_forward = true;
+                break;
+            case Argopt_profile:
+#ifndef FEAT_PROFILE
+                fprintf(stderr, "This build has no profiling, rebuild with PROFILE_ENABLED=1.\n");
+                return 1;
+#endif
+                profile = true;
+                break;
+            case Argopt_chunked:
+                chunked = true;
+                break;
+            case Argopt_canvas:
+                if (sscanf(optarg, "%zux%zu", &canvas_width, &canvas_height) != 2 ||
+                    canvas_width == 0 || canvas_height == 0 || canvas_width > CFIELD_DIM_MAX ||
+                    canvas_height > CFIELD_DIM_MAX) {
+                    fprintf(
+                        stderr,
+                        "Bad canvas size argument %s.\n"
+                        "Expected something like: 100000x50000\n",
+                        optarg);
+                    return 1;
+                }
+                chunked = true;
+                break;
+            case Argopt_smf:
+                smf_file = optarg;
+                break;
+            case Argopt_events:
+                events_file = optarg;
+                break;
+            case Argopt_frames:
+                frames_file = optarg;
+                break;
+            case Argopt_bpm:
+                bpm = atoi(optarg);
+                if (bpm < 4) {
+                    fprintf(
+                        stderr,
+                        "Bad BPM argument %s.\n"
+                        "Must be 4 or more, the slowest a MIDI file can have.\n",
+                        optarg);
+                    return 1;
+                }
+                break;
             case 'h':
                 usage();
                 return 0;
@@ -78,29 +499,206 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    if (chunked && (threads > 1 || check_parallel || fast_forward)) {
+        fprintf(
+            stderr,
+            "--chunked and --canvas don't work with -j, --check-parallel or "
+            "--fast-forward.\n");
+        return 1;
+    }
+    if (fast_forward && (smf_file || events_file || frames_file)) {
+        fprintf(stderr, "--smf, --events and --frames don't work with --fast-forward.\n");
+        return 1;
+    }
+    if (chunked && frames_file) {
+        fprintf(stderr, "--frames doesn't work with --chunked or --canvas.\n");
+        return 1;
+    }
+    if (smf_file && ticks > Smf_steps_max) {
+        fprintf(stderr, "--smf can take at most %d timesteps.\n", Smf_steps_max);
+        return 1;
+    }
+    Run_outputs outputs = { 0 };
+    Trace event_trace, frame_trace;
+    if (smf_file) {
+        FILE *file = open_output(smf_file);
+        if (!file)
+            return run_outputs_end(&outputs, 0, 1);
+        Smf_render *r = malloc(sizeof(Smf_render));
+        smf_init(&r->smf);
+        susnote_table_init(&r->susnotes);
+        r->file = file;
+        r->bpm = (Usz)bpm;
+        outputs.smf_render = r;
+        outputs.smf_file = smf_file;
+    }
+    if (events_file) {
+        FILE *file = open_output(events_file);
+        if (!file)
+            return run_outputs_end(&outputs, 0, 1);
+        trace_init(&event_trace, file);
+        outputs.events = &event_trace;
+        outputs.events_file = events_file;
+    }
+    if (frames_file) {
+        FILE *file = open_output(frames_file);
+        if (!file)
+            return run_outputs_end(&outputs, 0, 1);
+        trace_init(&frame_trace, file);
+        outputs.frames = &frame_trace;
+        outputs.frames_file = frames_file;
+    }
+
+    if (chunked) {
+        int result = run_chunked(
+            input_file, (Usz)ticks, canvas_height, canvas_width, print_output, &outputs);
+#ifdef FEAT_PROFILE
+        if (profile && result == 0)
+            print_profile(stderr);
+#endif
+        return run_outputs_end(&outputs, (Usz)ticks, result);
+    }
+
     Field field;
     field_init(&field);
     Field_load_error fle = field_load_file(input_file, &field);
     if (fle != Field_load_error_ok) {
         field_deinit(&field);
         fprintf(stderr, "File load error: %s.\n", field_load_error_string(fle));
-        return 1;
+        return run_outputs_end(&outputs, 0, 1);
     }
+    if (outputs.frames)
+        trace_first_frame(outputs.frames, field.buffer, field.height, field.width);
     MarkBuf mbuf_r;
     markbuf_init(&mbuf_r);
     markbuf_ensure_size(&mbuf_r, field.height, field.width);
+    OccBuf obuf_r;
+    occbuf_init(&obuf_r);
+    Occword *obuf = occbuf_sync(&obuf_r, &field);
+    Oprog prog;
+    oprog_init(&prog);
     Oevent_list oevent_list;
     oevent_list_init(&oevent_list);
+    Opar *par = threads > 1 || check_parallel ? opar_create((Usz)threads) : NULL;
+    // The serial VM's copy of everything, for --check-parallel.
+    Field check_field;
+    field_init(&check_field);
+    MarkBuf check_mbuf_r;
+    markbuf_init(&check_mbuf_r);
+    OccBuf check_obuf_r;
+    occbuf_init(&check_obuf_r);
+    Occword *check_obuf = NULL;
+    Oprog check_prog;
+    oprog_init(&check_prog);
+    Oevent_list check_oevent_list;
+    oevent_list_init(&check_oevent_list);
+    if (check_parallel) {
+        field_copy(&field, &check_field);
+        markbuf_ensure_size(&check_mbuf_r, field.height, field.width);
+        check_obuf = occbuf_sync(&check_obuf_r, &check_field);
+    }
+    Cycle_finder cycle_finder;
+    if (fast_forward)
+        cycle_finder_init(&cycle_finder, &field);
+    Otick_deps tick_deps;
+    int result = 0;
     Usz max_ticks = (Usz)ticks;
     for (Usz i = 0; i < max_ticks; ++i) {
-        mbuffer_clear(mbuf_r.buffer, field.height, field.width);
+        markbuf_clear(&mbuf_r);
         oevent_list_clear(&oevent_list);
-        orca_run(field.buffer, mbuf_r.buffer, field.height, field.width, i, &oevent_list, 0);
+        memset(&tick_deps, 0, sizeof(tick_deps));
+        if (par) {
+            orca_run_par(
+                par,
+                field.buffer,
+                mbuf_r.buffer,
+                mbuf_r.dirty,
+                obuf,
+                &prog,
+                field.height,
+                field.width,
+                i,
+                &oevent_list,
+                0,
+                fast_forward ? &tick_deps : NULL);
+        } else {
+            orca_run(
+                field.buffer,
+                mbuf_r.buffer,
+                mbuf_r.dirty,
+                obuf,
+                &prog,
+                field.height,
+                field.width,
+                i,
+                &oevent_list,
+                0,
+                fast_forward ? &tick_deps : NULL);
+        }
+        run_outputs_tick(&outputs, i, &oevent_list, field.buffer);
+        if (fast_forward) {
+            Usz period = cycle_finder_step(&cycle_finder, &field, i, &tick_deps);
+            if (period) {
+                fprintf(
+                    stderr,
+                    "Found a period of %zu timesteps, starting by timestep %zu.\n",
+                    period,
+                    cycle_finder.saved_tick);
+                i += (max_ticks - i - 1) / period * period;
+                cycle_finder_deinit(&cycle_finder);
+                fast_forward = false;
+            }
+        }
+        if (!check_parallel)
+            continue;
+        markbuf_clear(&check_mbuf_r);
+        oevent_list_clear(&check_oevent_list);
+        orca_run(
+            check_field.buffer,
+            check_mbuf_r.buffer,
+            check_mbuf_r.dirty,
+            check_obuf,
+            &check_prog,
+            check_field.height,
+            check_field.width,
+            i,
+            &check_oevent_list,
+            0,
+            NULL);
+        char const *what = diff_runs(
+            &field,
+            mbuf_r.buffer,
+            &oevent_list,
+            &check_field,
+            check_mbuf_r.buffer,
+            &check_oevent_list);
+        if (what) {
+            fprintf(stderr, "Parallel and serial runs differ at timestep %zu: %s.\n", i, what);
+            result = 1;
+            break;
+        }
     }
+    if (fast_forward)
+        cycle_finder_deinit(&cycle_finder);
+    if (par)
+        opar_destroy(par);
+    field_deinit(&check_field);
+    markbuf_deinit(&check_mbuf_r);
+    occbuf_deinit(&check_obuf_r);
+    oprog_deinit(&check_prog);
+    oevent_list_deinit(&check_oevent_list);
     markbuf_deinit(&mbuf_r);
+    occbuf_deinit(&obuf_r);
+    oprog_deinit(&prog);
     oevent_list_deinit(&oevent_list);
-    if (print_output)
+    if (print_output && result == 0)
         field_fput(&field, stdout);
+#ifdef FEAT_PROFILE
+    if (profile)
+        print_profile(stderr);
+#else
+    (void)profile;
+#endif
     field_deinit(&field);
-    return 0;
+    return run_outputs_end(&outputs, (Usz)ticks, result);
 }
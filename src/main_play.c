@@ -0,0 +1,451 @@
+#include "base.h"
+#include "field.h"
+#include "gbuffer.h"
+#include "sim.h"
+#include "vmio.h"
+#include "midi.h"
+#include "osc_out.h"
+#include "player.h"
+#include "net.h"
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+
+#define SOKOL_IMPL
+#include "sokol_time.h"
+#undef SOKOL_IMPL
+
+// Plays a patch in real time, the way orca does with the same file, BPM and
+// settings, but with nothing on the terminal. Doesn't link curses. For
+// machines with no TTY, or when drawing would only get in the way of the
+// timing.
+
+static ORCA_NOINLINE void usage(void)
+{ // clang-format off
+fprintf(stderr,
+"Usage: play [options] infile\n\n"
+"Plays the file in real time until interrupted, with no user interface.\n\n"
+"General options:\n"
+"    --bpm <number>         Set the tempo (beats per minute).\n"
+"                           Default: 120\n"
+"    --seed <number>        Set the seed for the random function.\n"
+"                           Default: 1\n"
+"    -t <number>            Stop after this many timesteps.\n"
+"                           Default: 0 (never stop)\n"
+"    --shm <name>           Publish each timestep's grid, marks and\n"
+"                           events to this POSIX shared memory\n"
+"                           segment, for other programs to watch.\n"
+"                           Example: /orca\n"
+"    -h or --help           Print this message and exit.\n"
+"\n"
+"OSC/MIDI options:\n"
+"    --osc-server <address>\n"
+"        Send OSC and UDP output to this host.\n"
+"        Default: loopback\n"
+"\n"
+"    --osc-port <number>\n"
+"        Send OSC and UDP output to this port. There's only OSC\n"
+"        output to this port and host if this or --osc-server is\n"
+"        given.\n"
+"        Default: 49162\n"
+"\n"
+"    --osc-dest <[host]:port[,only=osc+udp+midi][,ttl=N][,if=name]>\n"
+"        Also send output to this destination. Can be given more than\n"
+"        once. only= limits it to OSC from '=' and /orca/ messages,\n"
+"        UDP from ';', and MIDI sent with --osc-midi-bidule. For a\n"
+"        multicast group, ttl= and if= set the TTL (or IPv6 hop limit)\n"
+"        and the interface, by name or IPv4 address. IPv6 hosts go in\n"
+"        square brackets.\n"
+"        Example: 239.0.0.1:49162,only=osc+midi,ttl=2\n"
+"\n"
+"    --osc-bundle\n"
+"        Send the OSC messages of each timestep, including MIDI sent\n"
+"        with --osc-midi-bidule, together in one timetagged bundle.\n"
+"\n"
+"    --osc-midi-bidule <path>\n"
+"        Set MIDI to be sent via OSC formatted for Plogue Bidule.\n"
+"        The path argument is the path of the Plogue OSC MIDI device.\n"
+"        Example: /OSC_MIDI_0/MIDI\n"
+#ifdef FEAT_PORTMIDI
+"\n"
+"    --midi-output-device <name>\n"
+"        Send MIDI to the PortMidi output device with this name.\n"
+#endif
+"\n"
+"    --midi-beat-clock\n"
+"        Send MIDI beat clock, start and stop.\n"
+"\n"
+"    --strict-timing\n"
+"        Reduce the timing jitter of outgoing MIDI and OSC messages.\n"
+"        Uses more CPU time.\n"
+"\n"
+"    --lookahead <number>\n"
+"        Timestamp outgoing MIDI and OSC messages to be played this many\n"
+"        milliseconds after their step, so how late the step ran\n"
+"        doesn't show. OSC is sent in timetagged bundles. 0 to 1000.\n"
+"        Default: 0 (send right away)\n"
+);} // clang-format on
+
+static volatile sig_atomic_t play_interrupted = 0;
+
+static void play_on_signal(int signo)
+{
+    (void)signo;
+    play_interrupted = 1;
+}
+
+// Everything a tick touches. After the ticker starts, only with its lock held.
+typedef struct {
+    Field field;
+    MarkBuf mbuf_r;
+    OccBuf obuf_r;
+    Oprog prog;
+    Oevent_list oevent_list;
+    Susnote_table susnotes;
+    Play_clock play_clock;
+    Oosc_dev *oosc_dev;
+    Midi_mode midi_mode;
+    Net_shm *net_shm; // If set, each tick gets published to it
+    Usz bpm, random_seed, lookahead_ms;
+    Usz tick_num, tick_limit; // No limit if 0
+    bool midi_bclock;
+} Player;
+
+static bool player_step_due(void *userdata, U64 *due)
+{
+    Player *p = userdata;
+    if (p->tick_limit && p->tick_num == p->tick_limit)
+        return false;
+    *due = play_clock_step_due(&p->play_clock, p->bpm, p->midi_bclock);
+    return true;
+}
+
+static bool player_step(void *userdata)
+{
+    Player *p = userdata;
+    if (!play_clock_step(
+            &p->play_clock,
+            p->bpm,
+            p->midi_bclock,
+            p->lookahead_ms,
+            p->oosc_dev,
+            &p->midi_mode,
+            &p->susnotes))
+        return false;
+    markbuf_clear(&p->mbuf_r);
+    oevent_list_clear(&p->oevent_list);
+    orca_run(
+        p->field.buffer,
+        p->mbuf_r.buffer,
+        p->mbuf_r.dirty,
+        occbuf_sync(&p->obuf_r, &p->field),
+        &p->prog,
+        p->field.height,
+        p->field.width,
+        p->tick_num,
+        &p->oevent_list,
+        p->random_seed,
+        NULL);
+    if (p->net_shm)
+        net_shm_publish(
+            p->net_shm,
+            p->field.buffer,
+            p->mbuf_r.buffer,
+            p->field.height,
+            p->field.width,
+            p->tick_num,
+            p->oevent_list.buffer,
+            p->oevent_list.size,
+            p->oevent_list.count);
+    ++p->tick_num;
+    if (p->oevent_list.count > 0) {
+        play_clock_output_at_step(&p->play_clock, p->lookahead_ms, p->oosc_dev, &p->midi_mode);
+        send_output_events(p->oosc_dev, &p->midi_mode, &p->susnotes, &p->oevent_list);
+        play_output_now(p->oosc_dev, &p->midi_mode);
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    enum
+    {
+        Argopt_bpm = UCHAR_MAX + 1,
+        Argopt_seed,
+        Argopt_shm,
+        Argopt_osc_server,
+        Argopt_osc_port,
+        Argopt_osc_midi_bidule,
+        Argopt_midi_output_device,
+        Argopt_midi_beat_clock,
+        Argopt_strict_timing,
+        Argopt_lookahead,
+        Argopt_osc_bundle,
+        Argopt_osc_dest,
+    };
+    static struct option play_options[] = {
+        { "help", no_argument, 0, 'h' },
+        { "bpm", required_argument, 0, Argopt_bpm },
+        { "seed", required_argument, 0, Argopt_seed },
+        { "shm", required_argument, 0, Argopt_shm },
+        { "osc-server", required_argument, 0, Argopt_osc_server },
+        { "osc-port", required_argument, 0, Argopt_osc_port },
+        { "osc-midi-bidule", required_argument, 0, Argopt_osc_midi_bidule },
+#ifdef FEAT_PORTMIDI
+        { "midi-output-device", required_argument, 0, Argopt_midi_output_device },
+#endif
+        { "midi-beat-clock", no_argument, 0, Argopt_midi_beat_clock },
+        { "strict-timing", no_argument, 0, Argopt_strict_timing },
+        { "lookahead", required_argument, 0, Argopt_lookahead },
+        { "osc-bundle", no_argument, 0, Argopt_osc_bundle },
+        { "osc-dest", required_argument, 0, Argopt_osc_dest },
+        { NULL, 0, NULL, 0 }
+    };
+    char const *input_file = NULL;
+    char const *osc_server = NULL;
+    char const *osc_port = NULL;
+    char const *osc_midi_bidule_path = NULL;
+    Oosc_dest osc_dests[16 + 1]; // And one more for --osc-server and --osc-port
+    Usz osc_dest_count = 0;
+    char const *midi_output_device = NULL;
+    char const *shm_name = NULL;
+    int bpm = 120;
+    int seed = 1;
+    int ticks = 0;
+    int lookahead_ms = 0;
+    bool osc_bundle = false;
+    bool midi_bclock = false;
+    bool strict_timing = false;
+    int longindex = 0;
+
+#define OPTFAIL(...)                                                                               \
+    {                                                                                              \
+        fprintf(stderr, "Bad %s argument: %s\n", play_options[longindex].name, optarg);            \
+        fprintf(stderr, __VA_ARGS__);                                                              \
+        fputc('\n', stderr);                                                                       \
+        exit(1);                                                                                   \
+    }
+
+    for (;;) {
+        int c = getopt_long(argc, argv, "t:h", play_options, &longindex);
+        if (c == -1)
+            break;
+        switch (c) {
+            case 't':
+                if (str_to_int(optarg, &ticks) && ticks >= 0)
+                    break;
+                fprintf(
+                    stderr,
+                    "Bad timestep argument %s.\nMust be 0 or a positive integer.\n",
+                    optarg);
+                exit(1);
+            case 'h':
+                usage();
+                exit(0);
+            case '?':
+                usage();
+                exit(1);
+            case Argopt_bpm:
+                if (str_to_int(optarg, &bpm) && bpm >= 1)
+                    break;
+                OPTFAIL("Must be positive integer.");
+            case Argopt_seed:
+                if (str_to_int(optarg, &seed) && seed >= 0)
+                    break;
+                OPTFAIL("Must be 0 or positive integer.");
+            case Argopt_shm:
+                shm_name = optarg;
+                break;
+            case Argopt_osc_server:
+                osc_server = optarg;
+                break;
+            case Argopt_osc_port:
+                osc_port = optarg;
+                break;
+            case Argopt_osc_midi_bidule:
+                osc_midi_bidule_path = optarg;
+                break;
+            case Argopt_midi_output_device:
+                midi_output_device = optarg;
+                break;
+            case Argopt_midi_beat_clock:
+                midi_bclock = true;
+                break;
+            case Argopt_strict_timing:
+                strict_timing = true;
+                break;
+            case Argopt_lookahead:
+                if (str_to_int(optarg, &lookahead_ms) && lookahead_ms >= 0 && lookahead_ms <= 1000)
+                    break;
+                OPTFAIL("Must be from 0 to 1000.");
+            case Argopt_osc_bundle:
+                osc_bundle = true;
+                break;
+            case Argopt_osc_dest:
+                if (osc_dest_count == ORCA_ARRAY_COUNTOF(osc_dests) - 1)
+                    OPTFAIL("At most %zu can be given.", ORCA_ARRAY_COUNTOF(osc_dests) - 1);
+                if (oosc_dest_parse(optarg, &osc_dests[osc_dest_count])) {
+                    ++osc_dest_count;
+                    break;
+                }
+                OPTFAIL("Must be like [host]:port[,only=osc+udp+midi][,ttl=N][,if=name].");
+        }
+    }
+#undef OPTFAIL
+
+    if (optind == argc - 1) {
+        input_file = argv[optind];
+    } else if (optind == argc) {
+        fprintf(stderr, "No input file.\n");
+        usage();
+        return 1;
+    } else {
+        fprintf(stderr, "Expected only 1 file argument.\n");
+        return 1;
+    }
+    if (osc_midi_bidule_path && midi_output_device) {
+        fprintf(stderr, "Only one of --osc-midi-bidule and --midi-output-device can be used.\n");
+        return 1;
+    }
+
+    Player player;
+    Player *p = &player;
+    field_init(&p->field);
+    Field_load_error fle = field_load_file(input_file, &p->field);
+    if (fle != Field_load_error_ok) {
+        field_deinit(&p->field);
+        fprintf(stderr, "File load error: %s.\n", field_load_error_string(fle));
+        return 1;
+    }
+
+    p->net_shm = NULL;
+    if (shm_name) {
+        p->net_shm = net_shm_create(shm_name);
+        if (!p->net_shm) {
+            field_deinit(&p->field);
+            fprintf(stderr, "Couldn't create shared memory %s: %s.\n", shm_name, strerror(errno));
+            return 1;
+        }
+    }
+    p->oosc_dev = NULL;
+    if (osc_server || osc_port) {
+        osc_dests[osc_dest_count++] = (Oosc_dest){
+            .addr = osc_server,
+            .port = osc_port ? osc_port : "49162",
+            .kinds = Oosc_kinds_all,
+        };
+    }
+    if (osc_dest_count) {
+        p->oosc_dev = oosc_dev_create();
+        for (Usz i = 0; i < osc_dest_count; ++i) {
+            Oosc_dest const *dest = &osc_dests[i];
+            if (oosc_dev_add_udp(p->oosc_dev, dest)) {
+                oosc_dev_destroy(p->oosc_dev);
+                if (p->net_shm)
+                    net_shm_destroy(p->net_shm);
+                field_deinit(&p->field);
+                fprintf(
+                    stderr,
+                    "Failed to set up OSC networking for %s port %s.\n",
+                    dest->addr ? dest->addr : "loopback",
+                    dest->port);
+                return 1;
+            }
+        }
+        oosc_dev_set_bundling(p->oosc_dev, osc_bundle);
+    }
+    midi_mode_init_null(&p->midi_mode);
+    if (osc_midi_bidule_path)
+        midi_mode_init_osc_bidule(&p->midi_mode, osc_midi_bidule_path);
+#ifdef FEAT_PORTMIDI
+    if (midi_output_device) {
+        PmError pmerr;
+        PmDeviceID devid;
+        Usz namelen = strlen(midi_output_device);
+        if (!portmidi_find_device_id_by_name(midi_output_device, namelen, &pmerr, &devid)) {
+            if (pmerr)
+                fprintf(stderr, "PortMidi error: %s\n", Pm_GetErrorText(pmerr));
+            else
+                fprintf(stderr, "No MIDI output device named %s.\n", midi_output_device);
+            goto fail;
+        }
+        pmerr = midi_mode_init_portmidi(&p->midi_mode, devid, (Usz)lookahead_ms);
+        if (pmerr) {
+            fprintf(stderr, "PortMidi error: %s\n", Pm_GetErrorText(pmerr));
+            goto fail;
+        }
+    }
+#endif
+
+    markbuf_init(&p->mbuf_r);
+    markbuf_ensure_size(&p->mbuf_r, p->field.height, p->field.width);
+    occbuf_init(&p->obuf_r);
+    oprog_init(&p->prog);
+    oevent_list_init(&p->oevent_list);
+    susnote_table_init(&p->susnotes);
+    play_clock_init(&p->play_clock);
+    p->bpm = (Usz)bpm;
+    p->random_seed = (Usz)seed;
+    p->lookahead_ms = (Usz)lookahead_ms;
+    p->tick_num = 0;
+    p->tick_limit = (Usz)ticks;
+    p->midi_bclock = midi_bclock;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = play_on_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    stm_setup();
+    send_num_message(p->oosc_dev, "/orca/bpm", (I32)p->bpm);
+    play_clock_start(&p->play_clock, p->bpm, p->midi_bclock, p->oosc_dev, &p->midi_mode);
+    Play_ticker_fns ticker_fns = { player_step_due, player_step, p };
+    Play_ticker *ticker = play_ticker_create(ticker_fns, strict_timing);
+    if (!ticker) {
+        fprintf(stderr, "Couldn't start the playback thread.\n");
+        play_interrupted = 1;
+    }
+    // The ticker does the playing. This thread waits for a signal, or for the
+    // last tick asked for with -t. A signal that lands just before poll() is
+    // only seen after the next tick.
+    while (!play_interrupted) {
+        struct pollfd pfd = { .fd = play_ticker_wake_fd(ticker), .events = POLLIN };
+        poll(&pfd, 1, -1);
+        play_ticker_lock(ticker);
+        play_ticker_clear_wake(ticker);
+        bool done = p->tick_limit && p->tick_num == p->tick_limit;
+        play_ticker_unlock(ticker);
+        if (done)
+            break;
+    }
+    if (ticker)
+        play_ticker_destroy(ticker);
+    play_clock_stop(p->midi_bclock, p->oosc_dev, &p->midi_mode, &p->susnotes);
+
+    markbuf_deinit(&p->mbuf_r);
+    occbuf_deinit(&p->obuf_r);
+    oprog_deinit(&p->prog);
+    oevent_list_deinit(&p->oevent_list);
+    midi_mode_deinit(&p->midi_mode);
+#ifdef FEAT_PORTMIDI
+    Pm_Terminate();
+#endif
+    if (p->oosc_dev)
+        oosc_dev_destroy(p->oosc_dev);
+    if (p->net_shm)
+        net_shm_destroy(p->net_shm);
+    field_deinit(&p->field);
+    return ticker ? 0 : 1;
+#ifdef FEAT_PORTMIDI
+fail:
+    if (p->oosc_dev)
+        oosc_dev_destroy(p->oosc_dev);
+    if (p->net_shm)
+        net_shm_destroy(p->net_shm);
+    field_deinit(&p->field);
+    return 1;
+#endif
+}
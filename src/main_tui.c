@@ -13,21 +13,17 @@
 #include "ged.h"
 #include "tui.h"
 
+#include <errno.h>
 #include <getopt.h>
 #include <locale.h>
+#include <poll.h>
+#include <unistd.h>
 
 #define SOKOL_IMPL
 #include "sokol_time.h"
 #undef SOKOL_IMPL
 
 
-
-#define TIME_DEBUG 0
-#if TIME_DEBUG
-static int spin_track_timeout = 0;
-#endif
-
-
 staticni void usage(void)
 { // clang-format off
 fprintf(stderr,
@@ -43,6 +39,10 @@ fprintf(stderr,
 "                           Default: 120\n"
 "    --seed <number>        Set the seed for the random function.\n"
 "                           Default: 1\n"
+"    --shm <name>           Publish each timestep's grid, marks and\n"
+"                           events to this POSIX shared memory\n"
+"                           segment, for other programs to watch.\n"
+"                           Example: /orca\n"
 "    -h or --help           Print this message and exit.\n"
 "\n"
 "OSC/MIDI options:\n"
@@ -50,10 +50,29 @@ fprintf(stderr,
 "        Attempt to reduce timing jitter of outgoing MIDI and OSC\n"
 "        messages. Uses more CPU time. May have no effect.\n"
 "\n"
+"    --lookahead <number>\n"
+"        Timestamp outgoing MIDI and OSC messages to be played this many\n"
+"        milliseconds after their step, so how late the step ran\n"
+"        doesn't show. OSC is sent in timetagged bundles. 0 to 1000.\n"
+"        Default: 0 (send right away)\n"
+"\n"
+"    --osc-bundle\n"
+"        Send the OSC messages of each timestep, including MIDI sent\n"
+"        with --osc-midi-bidule, together in one timetagged bundle.\n"
+"\n"
 "    --osc-midi-bidule <path>\n"
 "        Set MIDI to be sent via OSC formatted for Plogue Bidule.\n"
 "        The path argument is the path of the Plogue OSC MIDI device.\n"
 "        Example: /OSC_MIDI_0/MIDI\n"
+"\n"
+"    --osc-dest <[host]:port[,only=osc+udp+midi][,ttl=N][,if=name]>\n"
+"        Also send OSC output to this destination while it's turned on\n"
+"        in the menu. Can be given more than once. only= limits it to\n"
+"        OSC from '=' and /orca/ messages, UDP from ';', and MIDI sent\n"
+"        with --osc-midi-bidule. For a multicast group, ttl= and if=\n"
+"        set the TTL (or IPv6 hop limit) and the interface, by name or\n"
+"        IPv4 address. IPv6 hosts go in square brackets.\n"
+"        Example: 239.0.0.1:49162,only=osc+midi,ttl=2\n"
 );} // clang-format on
 
 
@@ -109,6 +128,16 @@ Ged ged;
 WINDOW *window_main = NULL;
 Tui tui;
 
+static bool ged_ticker_step_due(void *userdata, U64 *due)
+{
+    return ged_step_due(userdata, due);
+}
+
+static bool ged_ticker_step(void *userdata)
+{
+    return ged_do_stuff(userdata);
+}
+
 void main_init(int argc, char **argv)
 {
     enum
@@ -118,8 +147,12 @@ void main_init(int argc, char **argv)
         Argopt_init_grid_size,
         Argopt_osc_midi_bidule,
         Argopt_strict_timing,
+        Argopt_lookahead,
+        Argopt_osc_bundle,
+        Argopt_osc_dest,
         Argopt_bpm,
         Argopt_seed,
+        Argopt_shm,
         Argopt_portmidi_deprecated,
         Argopt_osc_deprecated,
     };
@@ -131,8 +164,12 @@ void main_init(int argc, char **argv)
         { "help", no_argument, 0, 'h' },
         { "osc-midi-bidule", required_argument, 0, Argopt_osc_midi_bidule },
         { "strict-timing", no_argument, 0, Argopt_strict_timing },
+        { "lookahead", required_argument, 0, Argopt_lookahead },
+        { "osc-bundle", no_argument, 0, Argopt_osc_bundle },
+        { "osc-dest", required_argument, 0, Argopt_osc_dest },
         { "bpm", required_argument, 0, Argopt_bpm },
         { "seed", required_argument, 0, Argopt_seed },
+        { "shm", required_argument, 0, Argopt_shm },
         { "portmidi-list-devices", no_argument, 0, Argopt_portmidi_deprecated },
         { "portmidi-output-device", required_argument, 0, Argopt_portmidi_deprecated },
         { "osc-server", required_argument, 0, Argopt_osc_deprecated },
@@ -141,10 +178,14 @@ void main_init(int argc, char **argv)
     };
     int init_bpm = 120;
     int init_seed = 1;
+    char const *shm_name = NULL;
+    int lookahead_ms = 0;
+    bool osc_bundle = false;
+    static Oosc_dest osc_dests[16]; // ged keeps pointing at these
+    Usz osc_dest_count = 0;
     int init_grid_dim_y = 25;
     int init_grid_dim_x = 57;
     bool explicit_initial_grid_size = false;
-    net_init();
     tui_init(&tui, &ged);
 
     int longindex = 0;
@@ -185,6 +226,9 @@ void main_init(int argc, char **argv)
                 if (str_to_int(optarg, &init_seed) && init_seed >= 0)
                     break;
                 OPTFAIL("Must be 0 or positive integer.");
+            case Argopt_shm:
+                shm_name = optarg;
+                break;
             case Argopt_init_grid_size:
                 if (sscanf(optarg, "%dx%d", &init_grid_dim_x, &init_grid_dim_y) != 2)
                     OPTFAIL("Bad format or count. Expected something like: 40x30");
@@ -206,6 +250,21 @@ void main_init(int argc, char **argv)
             case Argopt_strict_timing:
                 tui.strict_timing = true;
                 break;
+            case Argopt_lookahead:
+                if (str_to_int(optarg, &lookahead_ms) && lookahead_ms >= 0 && lookahead_ms <= 1000)
+                    break;
+                OPTFAIL("Must be from 0 to 1000.");
+            case Argopt_osc_bundle:
+                osc_bundle = true;
+                break;
+            case Argopt_osc_dest:
+                if (osc_dest_count == ORCA_ARRAY_COUNTOF(osc_dests))
+                    OPTFAIL("At most %zu can be given.", ORCA_ARRAY_COUNTOF(osc_dests));
+                if (oosc_dest_parse(optarg, &osc_dests[osc_dest_count])) {
+                    ++osc_dest_count;
+                    break;
+                }
+                OPTFAIL("Must be like [host]:port[,only=osc+udp+midi][,ttl=N][,if=name].");
             case Argopt_portmidi_deprecated:
                 fprintf(
                     stderr,
@@ -236,6 +295,32 @@ void main_init(int argc, char **argv)
 
     // Initialize the 'Grid EDitor' stuff. This sits underneath the TUI.
     ged_init(&ged, (Usz)tui.undo_history_limit, (Usz)init_bpm, (Usz)init_seed);
+    ged.lookahead_ms = (Usz)lookahead_ms;
+    ged.is_osc_bundling = osc_bundle;
+    ged.osc_dests = osc_dests;
+    ged.osc_dest_count = osc_dest_count;
+#ifdef FEAT_PROFILE
+    // The profile only counts ticks the ticker runs, and only adds them to
+    // the totals with the lock held, so this thread can show them.
+    orca_profile_into(NULL);
+#endif
+    if (shm_name) {
+        ged.net_shm = net_shm_create(shm_name);
+        if (!ged.net_shm) {
+            fprintf(stderr, "Couldn't create shared memory %s: %s.\n", shm_name, strerror(errno));
+            exit(1);
+        }
+    }
+
+    // Ticks run on their own thread from here on. This one holds the lock on
+    // ged except while it waits for something to do (see main()).
+    Play_ticker_fns ticker_fns = { ged_ticker_step_due, ged_ticker_step, &ged };
+    ged.ticker = play_ticker_create(ticker_fns, tui.strict_timing);
+    if (!ged.ticker) {
+        fprintf(stderr, "Couldn't start the playback thread.\n");
+        exit(1);
+    }
+    play_ticker_lock(ged.ticker);
 
     // This will need to be changed to work with conf/menu
     if (osolen(tui.osc_midi_bidule_path) > 0) {
@@ -335,7 +420,6 @@ int main(int argc, char **argv)
     ORCA_LOG_INFO();
     main_init(argc, argv);
 
-    int cur_timeout = 0;
     bool is_in_brackpaste = false;
     Usz brackpaste_starting_x = 0;
     Usz brackpaste_y = 0;
@@ -345,13 +429,13 @@ int main(int argc, char **argv)
 
 event_loop:;
     int key = wgetch(stdscr);
-    if (cur_timeout != 0) {
-        wtimeout(stdscr, 0); // Until we run out, don't wait between events.
-        cur_timeout = 0;
-    }
     switch (key) {
         case ERR: { // ERR indicates no more events.
-            ged_do_stuff(&ged);
+            // The newest tick the ticker finished, if there's one we haven't
+            // seen. Drawing it doesn't need the lock: the ticker keeps to its
+            // own copy of the grid, so it can go on to the next one.
+            ged_take_sim_frame(&ged);
+            play_ticker_unlock(ged.ticker);
             bool drew_any = false;
             if (ged_is_draw_dirty(&ged) || qnav_stack.occlusion_dirty) {
                 werase(window_main);
@@ -367,63 +451,16 @@ event_loop:;
             drew_any |= qnav_draw(); // clears qnav_stack.occlusion_dirty
             if (drew_any)
                 doupdate();
-            double secs_to_d = ged_secs_to_deadline(&ged);
-
-// clang-format off
-#define DEADTIME(_millisecs, _new_timeout)                                                         \
-    else if (secs_to_d < ms_to_sec(_millisecs)) new_timeout = _new_timeout;
-
-            int new_timeout;
-            // These values are tuned to work OK with the normal scheduling behavior
-            // on Linux, Mac, and Windows. All of the usual caveats of trying to
-            // guess what the scheduler will do apply.
-            //
-            // Of course, there's no guarantee about how the scheduler will work, so
-            // if you are using a modified kernel or something, or the measurements
-            // here are bad, or it's some OS that behaves differently than expected,
-            // this won't be very good. But there's not really much we can do about
-            // it, and it's better than doing nothing and burning up the CPU!
-
-            if (tui.strict_timing) {
-              if (false) {}
-              // "If there's less than 1.5 milliseconds to the deadline, use a curses
-              // timeout value of 0."
-              DEADTIME(  1.5,  0)
-              DEADTIME(  3.0,  1)
-              DEADTIME(  5.0,  2)
-              DEADTIME(  7.0,  3)
-              DEADTIME(  9.0,  4)
-              DEADTIME( 11.0,  5)
-              DEADTIME( 13.0,  6)
-              DEADTIME( 15.0,  7)
-              DEADTIME( 25.0, 12)
-              DEADTIME( 50.0, 20)
-              DEADTIME(100.0, 40)
-              else new_timeout = 50;
-            } else {
-              if (false) {}
-              DEADTIME(  1.0,  0)
-              DEADTIME(  2.0,  1)
-              DEADTIME(  7.0,  2)
-              DEADTIME( 15.0,  5)
-              DEADTIME( 25.0, 10)
-              DEADTIME( 50.0, 20)
-              DEADTIME(100.0, 40)
-              else new_timeout = 50;
-            }
-#undef DEADTIME
-
-            if (new_timeout != cur_timeout) {
-                wtimeout(stdscr, new_timeout);
-                cur_timeout = new_timeout;
-        #if TIME_DEBUG
-                spin_track_timeout = cur_timeout;
-        #endif
-            }
+            struct pollfd pfds[2] = {
+                { .fd = STDIN_FILENO, .events = POLLIN },
+                { .fd = play_ticker_wake_fd(ged.ticker), .events = POLLIN },
+            };
+            poll(pfds, ORCA_ARRAY_COUNTOF(pfds), 50);
+            play_ticker_lock(ged.ticker);
+            play_ticker_clear_wake(ged.ticker);
             goto event_loop;
         }
         // END Case: ERR
-        // clang-format on
         case KEY_RESIZE:
             tui_adjust_term_size(&tui, &window_main);
             qnav_adjust_term_size();
@@ -503,6 +540,7 @@ event_loop:;
                         brackpaste_y,
                         brackpaste_x,
                         cleaned);
+                    ged_field_edited(&ged, brackpaste_y, brackpaste_x, 1, 1);
                     // Could move this out one level if we wanted the final selection
                     // size to reflect even the pasted area which didn't fit on the
                     // grid.
@@ -541,9 +579,7 @@ event_loop:;
             ged_input_cmd(&ged, Ged_input_cmd_undo);
             break;
         case CTRL_PLUS('r'):
-            ged.tick_num = 0;
-            ged.needs_remarking = true;
-            ged.is_draw_dirty = true;
+            ged_set_tick_num(&ged, 0);
             break;
         case '[':
             ged_adjust_rulers_relative(&ged, 0, -1);
@@ -619,12 +655,21 @@ event_loop:;
                 if (cberr) {
                     if (added_hist)
                         undo_history_pop(&ged.undo_hist, &ged.field, &ged.tick_num);
+                    // cboard_paste() may have written part of the field before
+                    // failing.
+                    ged_field_replaced(&ged);
                     tui.use_gui_cboard = false;
                     ged_input_cmd(&ged, Ged_input_cmd_paste);
                 } else {
                     if (pasted_h > 0 && pasted_w > 0) {
                         ged.ged_cursor.h = pasted_h;
                         ged.ged_cursor.w = pasted_w;
+                        ged_field_edited(
+                            &ged,
+                            ged.ged_cursor.y,
+                            ged.ged_cursor.x,
+                            pasted_h,
+                            pasted_w);
                     }
                 }
                 ged.needs_remarking = true;
@@ -764,6 +809,9 @@ event_loop:;
     }
     goto event_loop;
 quit:
+    play_ticker_unlock(ged.ticker);
+    play_ticker_destroy(ged.ticker);
+    ged.ticker = NULL;
     ged_stop_all_sustained_notes(&ged);
     qnav_deinit();
     if (window_main)
@@ -774,6 +822,8 @@ quit:
     printf("\033[?2004h\n"); // Tell terminal to not use bracketed paste
     endwin();
     ged_deinit(&ged);
+    if (ged.net_shm)
+        net_shm_destroy(ged.net_shm);
     osofree(tui.file_name);
     osofree(tui.osc_address);
     osofree(tui.osc_port);
@@ -53,23 +53,22 @@ PmTimestamp portmidi_timeproc(void *time_info)
 }
 
 
-PmError midi_mode_init_portmidi(Midi_mode *mm, PmDeviceID dev_id)
+PmError midi_mode_init_portmidi(Midi_mode *mm, PmDeviceID dev_id, Usz lookahead_ms)
 {
+    PmTimestamp latency_ms = Portmidi_artificial_latency;
+    if (lookahead_ms > (Usz)latency_ms)
+        latency_ms = (PmTimestamp)lookahead_ms;
     PmError e = portmidi_init_if_necessary();
     if (e)
         goto fail;
-    e = Pm_OpenOutput(
-        &mm->portmidi.stream,
-        dev_id,
-        NULL,
-        128,
-        portmidi_timeproc,
-        NULL,
-        Portmidi_artificial_latency);
+    e = Pm_OpenOutput(&mm->portmidi.stream, dev_id, NULL, 128, portmidi_timeproc, NULL, latency_ms);
     if (e)
         goto fail;
     mm->portmidi.type = Midi_mode_type_portmidi;
     mm->portmidi.device_id = dev_id;
+    mm->portmidi.latency_ms = latency_ms;
+    mm->portmidi.timestamp = 0;
+    mm->portmidi.is_delayed = false;
     return pmNoError;
 fail:
     midi_mode_init_null(mm);
@@ -117,6 +116,26 @@ bool portmidi_find_name_of_device_id(PmDeviceID id, PmError *out_pmerror, oso **
 }
 #endif
 
+void midi_mode_set_delay(Midi_mode *mm, double secs)
+{
+    switch (mm->any.type) {
+        case Midi_mode_type_null:
+        case Midi_mode_type_osc_bidule:
+            break;
+#ifdef FEAT_PORTMIDI
+        case Midi_mode_type_portmidi:
+            mm->portmidi.is_delayed = secs >= 0.0;
+            if (!mm->portmidi.is_delayed)
+                break;
+            // PortMidi plays a message at its timestamp plus the stream's
+            // latency.
+            mm->portmidi.timestamp = portmidi_timestamp_now() + (PmTimestamp)(secs * 1000.0) -
+                                     mm->portmidi.latency_ms;
+            break;
+#endif
+    }
+}
+
 void midi_mode_deinit(Midi_mode *mm)
 {
     switch (mm->any.type) {
@@ -135,7 +154,7 @@ void midi_mode_deinit(Midi_mode *mm)
             //
             // TODO use nansleep on platforms that support it.
             for (U64 start = stm_now();
-                 stm_ms(stm_since(start)) <= (double)Portmidi_artificial_latency;)
+                 stm_ms(stm_since(start)) <= (double)mm->portmidi.latency_ms;)
                 sleep(0);
             Pm_Close(mm->portmidi.stream);
             break;
@@ -152,24 +171,28 @@ void send_midi_3bytes(Oosc_dev *oosc_dev, Midi_mode const *midi_mode, int status
         case Midi_mode_type_osc_bidule: {
             if (!oosc_dev)
                 break;
-            oosc_send_int32s(oosc_dev, midi_mode->osc_bidule.path, (int[]){ status, byte1, byte2 }, 3);
+            oosc_send_int32s(
+                oosc_dev,
+                Oosc_kind_midi,
+                midi_mode->osc_bidule.path,
+                (int[]){ status, byte1, byte2 },
+                3);
             break;
         }
 #ifdef FEAT_PORTMIDI
         case Midi_mode_type_portmidi: {
-            // timestamp is totally fake, to prevent problems with some MIDI systems
-            // getting angry if there's no timestamping info.
-            //
-            // Eventually, we will want to create real timestamps based on a real orca
-            // clock, instead of ad-hoc at the last moment like this. When we do that,
-            // we'll need to thread the timestamping/timing info through the function
-            // calls, instead of creating it at the last moment here. (This timestamp
-            // is actually 'useless', because it doesn't convey any additional
-            // information. But if we don't provide it, at least to PortMidi, some
-            // people's MIDI setups may malfunction and have terrible timing problems.)
-            PmTimestamp pm_timestamp = portmidi_timestamp_now();
+            // With a delay set (see midi_mode_set_delay()), the timestamp is a
+            // real one, from when the step that sent this was due on orca's
+            // clock. Otherwise it's totally fake, to prevent problems with some
+            // MIDI systems getting angry if there's no timestamping info. (That
+            // timestamp is actually 'useless', because it doesn't convey any
+            // additional information. But if we don't provide it, at least to
+            // PortMidi, some people's MIDI setups may malfunction and have
+            // terrible timing problems.)
+            Midi_mode_portmidi const *pm = &midi_mode->portmidi;
+            PmTimestamp pm_timestamp = pm->is_delayed ? pm->timestamp : portmidi_timestamp_now();
             PmError pme = Pm_WriteShort(
-                midi_mode->portmidi.stream,
+                pm->stream,
                 pm_timestamp,
                 Pm_Message(status, byte1, byte2));
             (void)pme;
@@ -193,18 +216,12 @@ void send_midi_chan_msg(
 void send_midi_note_offs(
     Oosc_dev *oosc_dev,
     Midi_mode *midi_mode,
-    Susnote const *start,
-    Susnote const *end)
-{
-    for (; start != end; ++start) {
-#if 0
-    float under = start->remaining;
-    if (under < 0.0) {
-      fprintf(stderr, "cutoff slop: %f\n", under);
-    }
-#endif
-        U16 chan_note = start->chan_note;
-        send_midi_chan_msg(oosc_dev, midi_mode, 0x8, chan_note >> 8, chan_note & 0xFF, 0);
+    U16 const *notes,
+    Usz count)
+{
+    for (Usz i = 0; i < count; ++i) {
+        U16 note = notes[i];
+        send_midi_chan_msg(oosc_dev, midi_mode, 0x8, note >> 7, note & 0x7F, 0);
     }
 }
 
@@ -212,7 +229,7 @@ void send_control_message(Oosc_dev *oosc_dev, char const *osc_address)
 {
     if (!oosc_dev)
         return;
-    oosc_send_int32s(oosc_dev, osc_address, NULL, 0);
+    oosc_send_int32s(oosc_dev, Oosc_kind_osc, osc_address, NULL, 0);
 }
 
 void send_num_message(Oosc_dev *oosc_dev, char const *osc_address, I32 num)
@@ -221,7 +238,7 @@ void send_num_message(Oosc_dev *oosc_dev, char const *osc_address, I32 num)
         return;
     I32 nums[1];
     nums[0] = num;
-    oosc_send_int32s(oosc_dev, osc_address, nums, ORCA_ARRAY_COUNTOF(nums));
+    oosc_send_int32s(oosc_dev, Oosc_kind_osc, osc_address, nums, ORCA_ARRAY_COUNTOF(nums));
 }
 
 void send_midi_byte(Oosc_dev *oosc_dev, Midi_mode const *midi_mode, int x)
@@ -28,6 +28,9 @@ typedef struct {
     Midi_mode_type type;
     PmDeviceID device_id;
     PortMidiStream *stream;
+    PmTimestamp latency_ms; // What the stream was opened with
+    PmTimestamp timestamp;  // For what's sent next, if is_delayed
+    bool is_delayed;
 } Midi_mode_portmidi;
 // Not sure whether it's OK to call Pm_Terminate() without having a successful
 // call to Pm_Initialize() -- let's just treat it with tweezers.
@@ -47,11 +50,17 @@ void midi_mode_deinit(Midi_mode *mm);
 
 void midi_mode_init_osc_bidule(Midi_mode *mm, char const *path);
 
+// MIDI sent after this is timestamped to be played secs from now, if the
+// output keeps time. Less than 0 goes back to sending it to be played right
+// away. OSC Bidule output is delayed through the Oosc_dev instead.
+void midi_mode_set_delay(Midi_mode *mm, double secs);
+
+// notes are channel << 7 | number, as in Susnote.
 void send_midi_note_offs(
     Oosc_dev *oosc_dev,
     Midi_mode *midi_mode,
-    Susnote const *start,
-    Susnote const *end);
+    U16 const *notes,
+    Usz count);
 
 void send_midi_chan_msg(
     Oosc_dev *oosc_dev,
@@ -73,6 +82,8 @@ PmError portmidi_init_if_necessary(void);
 
 bool portmidi_find_device_id_by_name(char const *name, Usz namelen, PmError *out_pmerror, PmDeviceID *out_id);
 
-PmError midi_mode_init_portmidi(Midi_mode *mm, PmDeviceID dev_id);
+// With lookahead_ms, the stream is opened with that much latency, so MIDI
+// delayed up to that far ahead with midi_mode_set_delay() plays on time.
+PmError midi_mode_init_portmidi(Midi_mode *mm, PmDeviceID dev_id, Usz lookahead_ms);
 
 bool portmidi_find_name_of_device_id(PmDeviceID id, PmError *out_pmerror, oso **out_name);
@@ -1,19 +1,109 @@
 #include "net.h"
-#include <iostream>
-#include <pEp/std_utils.hh>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
-namespace Orca {
-    int counter{ 0 };
-}
+struct Net_shm {
+    std::mutex mtx; // Ticks come from the ticker's thread, and from stepping by hand
+    std::string name;
+    int fd;
+    U8 *map;
+    Usz size;
+};
 
+namespace Orca {
+    namespace Net {
+        // Grows the segment to fit at least size bytes, in whole pages, and at
+        // least doubling so it doesn't have to happen often. The new mapping
+        // is made before the old one goes, so a failure leaves it as it was.
+        bool shm_grow(Net_shm *shm, Usz size)
+        {
+            Usz page = (Usz)sysconf(_SC_PAGESIZE);
+            if (size < shm->size * 2)
+                size = shm->size * 2;
+            size = (size + page - 1) / page * page;
+            if (ftruncate(shm->fd, (off_t)size) != 0)
+                return false;
+            void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm->fd, 0);
+            if (map == MAP_FAILED)
+                return false;
+            if (shm->map)
+                munmap(shm->map, shm->size);
+            shm->map = static_cast<U8 *>(map);
+            shm->size = size;
+            auto *h = reinterpret_cast<Net_shm_header *>(map);
+            __atomic_store_n(&h->size, (U64)size, __ATOMIC_RELEASE);
+            return true;
+        }
+    } // namespace Net
+} // namespace Orca
 
-void net_init() {
-    pEp::Utils::file_create("field.comm");
+Net_shm *net_shm_create(char const *name)
+{
+    // Readers of a segment from before keep it, and it just stops changing.
+    shm_unlink(name);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0)
+        return nullptr;
+    auto *shm = new Net_shm;
+    shm->name = name;
+    shm->fd = fd;
+    shm->map = nullptr;
+    shm->size = 0;
+    // Room for the default 25x57 grid and a busy tick to begin with
+    if (!Orca::Net::shm_grow(shm, sizeof(Net_shm_header) + 25 * 57 * 2 + 4096)) {
+        int err = errno;
+        net_shm_destroy(shm);
+        errno = err;
+        return nullptr;
+    }
+    auto *h = reinterpret_cast<Net_shm_header *>(shm->map);
+    h->version = Net_shm_version;
+    h->glyphs_at = h->marks_at = h->events_at = sizeof(Net_shm_header);
+    __atomic_store_n(&h->magic, (U32)Net_shm_magic, __ATOMIC_RELEASE);
+    return shm;
 }
 
-void net_test_cxx(Glyph* gbuf, Mark* mbuf, Usz height, Usz width, Usz tick_number)
+void net_shm_destroy(Net_shm *shm)
 {
-    Orca::counter++;
-    std::cout << "test_cxx()" << Orca::counter << std::endl;
+    if (shm->map)
+        munmap(shm->map, shm->size);
+    close(shm->fd);
+    shm_unlink(shm->name.c_str());
+    delete shm;
 }
 
+void net_shm_publish(Net_shm *shm, Glyph const *gbuf, Mark const *mbuf, Usz height, Usz width,
+                     Usz tick_num, U8 const *events, Usz events_size, Usz event_count)
+{
+    std::lock_guard<std::mutex> lock(shm->mtx);
+    Usz cells = height * width;
+    Usz glyphs_at = sizeof(Net_shm_header);
+    Usz marks_at = glyphs_at + cells * sizeof(Glyph);
+    Usz events_at = marks_at + cells * sizeof(Mark);
+    // If it can't grow, readers keep seeing the last tick that fit.
+    if (events_at + events_size > shm->size && !Orca::Net::shm_grow(shm, events_at + events_size))
+        return;
+    auto *h = reinterpret_cast<Net_shm_header *>(shm->map);
+    // Only this writes seq, so it doesn't need to be read atomically here.
+    U64 seq = h->seq;
+    __atomic_store_n(&h->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    h->tick_num = tick_num;
+    h->height = height;
+    h->width = width;
+    h->glyphs_at = glyphs_at;
+    h->marks_at = marks_at;
+    h->events_at = events_at;
+    h->events_size = events_size;
+    h->event_count = event_count;
+    std::memcpy(shm->map + glyphs_at, gbuf, cells * sizeof(Glyph));
+    std::memcpy(shm->map + marks_at, mbuf, cells * sizeof(Mark));
+    if (events_size)
+        std::memcpy(shm->map + events_at, events, events_size);
+    __atomic_store_n(&h->seq, seq + 2, __ATOMIC_RELEASE);
+}
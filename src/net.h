@@ -9,12 +9,56 @@
 extern "C" {
 #endif
 
+// Publishes each tick to a POSIX shared memory segment, so programs on the
+// same machine can watch the grid by mapping it read-only, with no copying
+// and no sockets. The segment is a Net_shm_header, then the glyphs and the
+// marks, height * width of each, row by row, then the tick's events, back to
+// back as in vmio.h.
+//
+// Ticks are written under a seqlock. seq is odd while one is being written,
+// so a reader takes what it needs between two reads of seq, and keeps it if
+// both were the same even number:
+//
+//   for (;;) {
+//     U64 seq = __atomic_load_n(&h->seq, __ATOMIC_ACQUIRE);
+//     if (__atomic_load_n(&h->size, __ATOMIC_ACQUIRE) > mapped_size)
+//       map it again, and start over
+//     if (seq & 1)
+//       continue;
+//     read it, checking offsets and sizes against mapped_size first
+//     __atomic_thread_fence(__ATOMIC_ACQUIRE);
+//     if (__atomic_load_n(&h->seq, __ATOMIC_RELAXED) == seq)
+//       break;
+//   }
+//
+// The segment only grows, so an older mapping of it stays good, though it
+// might not reach as far as the newest tick.
 
-void net_init(void);
+enum { Net_shm_magic = 0x4143524F, Net_shm_version = 1 }; // "ORCA"
 
-void net_test_cxx(Glyph * gbuf,Mark * mbuf,Usz height,Usz width,Usz tick_number);
+typedef struct {
+    U32 magic; // Net_shm_magic once the rest is set up
+    U32 version;
+    U64 size; // Of the whole segment, in bytes
+    U64 seq;
+    // Only good between two matching reads of seq.
+    U64 tick_num; // Of the tick that made this
+    U64 height, width;
+    U64 glyphs_at, marks_at, events_at; // In bytes from the start
+    U64 events_size, event_count;
+} Net_shm_header;
 
+typedef struct Net_shm Net_shm;
 
+// Replaces any segment left with the same name, which should look like
+// "/name". Returns NULL, with errno set, if it can't.
+Net_shm *net_shm_create(char const *name);
+// Unlinks the segment. Readers that have it mapped keep the last tick.
+void net_shm_destroy(Net_shm *shm);
+
+// Can be called from any thread.
+void net_shm_publish(Net_shm *shm, Glyph const *gbuf, Mark const *mbuf, Usz height, Usz width,
+                     Usz tick_num, U8 const *events, Usz events_size, Usz event_count);
 
 #ifdef __cplusplus
 };
@@ -1,21 +1,151 @@
+#if defined(FEAT_SENDMMSG) && !defined(_GNU_SOURCE)
+    #define _GNU_SOURCE // sendmmsg()
+#endif
 #include "osc_out.h"
 #include <arpa/inet.h>
+#include <net/if.h>
 #include <errno.h>
 #include <netdb.h>
 #include <netinet/in.h>
 #include <stdio.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <time.h>
 
-struct Oosc_dev {
+// From the NTP epoch (1900) to the Unix one (1970), in seconds.
+#define OOSC_NTP_UNIX_OFFSET 2208988800u
+
+enum
+{
+    Oosc_bundle_header_size = 20, // "#bundle", timetag, element size
+    // Where a tick's bundle gets split into more, with the same timetag. Kept
+    // well under what receivers will take in one datagram.
+    Oosc_bundle_max_size = 8192,
+    Oosc_message_max_size = 2048,
+    Oosc_template_count = 64, // A power of 2
+    Oosc_template_address_max = 48, // Including the null
+    Oosc_template_ints_max = 62,
+    // Padded address, then ',', the 'i's and a null, padded
+    Oosc_template_header_max = Oosc_template_address_max + Oosc_template_ints_max + 2,
+};
+
+// The front of a message, up to where its ints go, which only depends on the
+// address and how many ints there are. Orca sends to a handful of addresses
+// ('/' and a glyph, or the Bidule path), so there's no need to pack the same
+// strings over again for every message.
+typedef struct {
+    char address[Oosc_template_address_max];
+    Usz count; // SIZE_MAX if the slot is free
+    Usz header_size;
+    char header[Oosc_template_header_max];
+} Oosc_template;
+
+// One destination. Datagrams for it are held in its own batch, and OSC
+// messages in its own bundle, since what goes to each one depends on its
+// kinds.
+typedef struct {
     int fd;
     // Just keep the whole list around, since juggling the strict-aliasing
     // problems with sockaddr_storage is not worth it.
     struct addrinfo *chosen;
     struct addrinfo *head;
+    U8 kinds; // Oosc_kind bits
+    // While batching, with oosc_dev_set_bundling(), OSC messages are added
+    // to this instead of being sent one by one. Empty if bundle_size is 0.
+    char *bundle;
+    Usz bundle_size;
+    // Held datagrams, back to back in batch_bytes. Each one ends where
+    // batch_ends says.
+    char *batch_bytes;
+    Usz *batch_ends;
+    Usz batch_size, batch_bytes_capacity;
+    Usz batch_count, batch_count_capacity;
+#ifdef FEAT_SENDMMSG
+    struct mmsghdr *msgs;
+    struct iovec *iovs;
+    Usz msgs_capacity;
+#endif
+} Oosc_out;
+
+struct Oosc_dev {
+    Oosc_out *outs;
+    Usz out_count;
+    U8 kinds; // Of all the outs together
+    U64 timetag; // NTP format. 0 if messages aren't being bundled.
+    Oosc_template templates[Oosc_template_count]; // By a hash of address and count
+    bool is_batching, is_bundling;
 };
 
-Oosc_udp_create_error oosc_dev_create_udp(Oosc_dev **out_ptr, char const *dest_addr, char const *dest_port)
+Oosc_dev *oosc_dev_create(void)
+{
+    Oosc_dev *dev = malloc(sizeof(Oosc_dev));
+    dev->outs = NULL;
+    dev->out_count = 0;
+    dev->kinds = 0;
+    dev->timetag = 0;
+    for (Usz i = 0; i < Oosc_template_count; ++i)
+        dev->templates[i].count = SIZE_MAX;
+    dev->is_batching = false;
+    dev->is_bundling = false;
+    return dev;
+}
+
+static bool oosc_set_multicast_if(int fd, int family, char const *iface)
+{
+    unsigned int ifindex;
+    if (family == AF_INET) {
+        struct in_addr if_addr;
+        if (inet_pton(AF_INET, iface, &if_addr) == 1)
+            return !setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &if_addr, sizeof if_addr);
+        ifindex = if_nametoindex(iface);
+        if (!ifindex)
+            return false;
+#if defined(__linux__)
+        struct ip_mreqn mreqn = { .imr_ifindex = (int)ifindex };
+        return !setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &mreqn, sizeof mreqn);
+#elif defined(IP_MULTICAST_IFINDEX)
+        return !setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IFINDEX, &ifindex, sizeof ifindex);
+#else
+        return false; // Only by address
+#endif
+    }
+    ifindex = if_nametoindex(iface);
+    if (!ifindex)
+        return false;
+    return !setsockopt(fd, IPPROTO_IPV6, IPV6_MULTICAST_IF, &ifindex, sizeof ifindex);
+}
+
+// The multicast options only matter for a multicast address, so for any
+// other they're left alone.
+static bool oosc_set_multicast(int fd, struct addrinfo const *ai, Oosc_dest const *dest)
+{
+    if (ai->ai_family == AF_INET) {
+        struct sockaddr_in const *sin = (struct sockaddr_in const *)(void const *)ai->ai_addr;
+        if (!IN_MULTICAST(ntohl(sin->sin_addr.s_addr)))
+            return true;
+        if (dest->multicast_ttl) {
+            unsigned char ttl = (unsigned char)dest->multicast_ttl;
+            if (setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof ttl))
+                return false;
+        }
+    } else if (ai->ai_family == AF_INET6) {
+        struct sockaddr_in6 const *sin6 = (struct sockaddr_in6 const *)(void const *)ai->ai_addr;
+        if (!IN6_IS_ADDR_MULTICAST(&sin6->sin6_addr))
+            return true;
+        if (dest->multicast_ttl) {
+            int hops = dest->multicast_ttl;
+            if (setsockopt(fd, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &hops, sizeof hops))
+                return false;
+        }
+    } else {
+        return true;
+    }
+    if (dest->multicast_if && !oosc_set_multicast_if(fd, ai->ai_family, dest->multicast_if))
+        return false;
+    return true;
+}
+
+Oosc_udp_create_error oosc_dev_add_udp(Oosc_dev *dev, Oosc_dest const *dest)
 {
     struct addrinfo hints = { 0 };
     hints.ai_family = AF_UNSPEC;
@@ -24,7 +154,7 @@ Oosc_udp_create_error oosc_dev_create_udp(Oosc_dev **out_ptr, char const *dest_a
     hints.ai_flags = AI_ADDRCONFIG;
     struct addrinfo *chosen = NULL;
     struct addrinfo *head = NULL;
-    int err = getaddrinfo(dest_addr, dest_port, &hints, &head);
+    int err = getaddrinfo(dest->addr, dest->port, &hints, &head);
     if (err != 0) {
 #if 0
     fprintf(stderr, "Failed to get address info, error: %d\n", errno);
@@ -78,24 +208,165 @@ Oosc_udp_create_error oosc_dev_create_udp(Oosc_dev **out_ptr, char const *dest_a
         freeaddrinfo(head);
         return Oosc_udp_create_error_couldnt_open_socket;
     }
-    Oosc_dev *dev = malloc(sizeof(Oosc_dev));
-    dev->fd = udpfd;
-    dev->chosen = chosen;
-    dev->head = head;
+    if (!oosc_set_multicast(udpfd, chosen, dest)) {
+        close(udpfd);
+        freeaddrinfo(head);
+        return Oosc_udp_create_error_multicast_failed;
+    }
+    dev->outs = realloc(dev->outs, (dev->out_count + 1) * sizeof(Oosc_out));
+    Oosc_out *out = &dev->outs[dev->out_count++];
+    out->fd = udpfd;
+    out->chosen = chosen;
+    out->head = head;
+    out->kinds = dest->kinds;
+    out->bundle = NULL;
+    out->bundle_size = 0;
+    out->batch_bytes = NULL;
+    out->batch_ends = NULL;
+    out->batch_size = out->batch_bytes_capacity = 0;
+    out->batch_count = out->batch_count_capacity = 0;
+#ifdef FEAT_SENDMMSG
+    out->msgs = NULL;
+    out->iovs = NULL;
+    out->msgs_capacity = 0;
+#endif
+    dev->kinds |= dest->kinds;
+    return Oosc_udp_create_error_ok;
+}
+
+Oosc_udp_create_error oosc_dev_create_udp(Oosc_dev **out_ptr, char const *dest_addr, char const *dest_port)
+{
+    Oosc_dev *dev = oosc_dev_create();
+    Oosc_dest dest = { .addr = dest_addr, .port = dest_port, .kinds = Oosc_kinds_all };
+    Oosc_udp_create_error err = oosc_dev_add_udp(dev, &dest);
+    if (err) {
+        oosc_dev_destroy(dev);
+        return err;
+    }
     *out_ptr = dev;
     return Oosc_udp_create_error_ok;
 }
 
+static bool oosc_parse_kinds(char const *str, Usz len, U8 *out)
+{
+    U8 kinds = 0;
+    for (char const *end = str + len; str < end;) {
+        Usz n = 0;
+        while (str + n < end && str[n] != '+')
+            ++n;
+        if (n == 3 && strncmp(str, "osc", 3) == 0)
+            kinds |= Oosc_kind_osc;
+        else if (n == 3 && strncmp(str, "udp", 3) == 0)
+            kinds |= Oosc_kind_udp;
+        else if (n == 4 && strncmp(str, "midi", 4) == 0)
+            kinds |= Oosc_kind_midi;
+        else
+            return false;
+        str += n + 1;
+    }
+    *out = kinds;
+    return kinds != 0;
+}
+
+bool oosc_dest_parse(char *spec, Oosc_dest *out)
+{
+    Oosc_dest dest = { .kinds = Oosc_kinds_all };
+    char *addr = spec, *addr_end, *port;
+    if (spec[0] == '[') {
+        addr = spec + 1;
+        addr_end = strchr(addr, ']');
+        if (!addr_end || addr_end[1] != ':')
+            return false;
+        port = addr_end + 2;
+    } else {
+        addr_end = strchr(spec, ':');
+        if (!addr_end)
+            return false;
+        port = addr_end + 1;
+    }
+    Usz port_len = strcspn(port, ",");
+    // An IPv6 address has to be in brackets
+    if (!port_len || memchr(port, ':', port_len))
+        return false;
+    for (char *opt = port + port_len; *opt; opt += strcspn(opt, ",")) {
+        ++opt; // Past the ','
+        Usz len = strcspn(opt, ",");
+        if (strncmp(opt, "only=", 5) == 0) {
+            if (!oosc_parse_kinds(opt + 5, len - 5, &dest.kinds))
+                return false;
+        } else if (strncmp(opt, "ttl=", 4) == 0) {
+            char *end;
+            long ttl = strtol(opt + 4, &end, 10);
+            if (end != opt + len || ttl < 1 || ttl > 255)
+                return false;
+            dest.multicast_ttl = (int)ttl;
+        } else if (len > 3 && strncmp(opt, "if=", 3) == 0) {
+            dest.multicast_if = opt + 3;
+        } else {
+            return false;
+        }
+    }
+    // It's good, so cut it up, which is left until now so spec is still
+    // whole for error messages if it isn't.
+    *addr_end = '\0';
+    for (char *c = port; (c = strchr(c, ',')); ++c)
+        *c = '\0';
+    dest.addr = addr_end == addr ? NULL : addr;
+    dest.port = port;
+    *out = dest;
+    return true;
+}
+
 void oosc_dev_destroy(Oosc_dev *dev)
 {
-    close(dev->fd);
-    freeaddrinfo(dev->head);
+    oosc_dev_flush(dev);
+    for (Usz i = 0; i < dev->out_count; ++i) {
+        Oosc_out *out = &dev->outs[i];
+        close(out->fd);
+        freeaddrinfo(out->head);
+        free(out->bundle);
+        free(out->batch_bytes);
+        free(out->batch_ends);
+#ifdef FEAT_SENDMMSG
+        free(out->msgs);
+        free(out->iovs);
+#endif
+    }
+    free(dev->outs);
     free(dev);
 }
 
-void oosc_send_datagram(Oosc_dev *dev, char const *data, Usz size)
+void oosc_dev_set_bundling(Oosc_dev *dev, bool bundling)
+{
+    dev->is_bundling = bundling;
+}
+
+void oosc_dev_begin_batch(Oosc_dev *dev)
+{
+    dev->is_batching = true;
+}
+
+static void oosc_out_send(Oosc_dev const *dev, Oosc_out *out, char const *data, Usz size)
 {
-    ssize_t res = sendto(dev->fd, data, size, 0, dev->chosen->ai_addr, dev->chosen->ai_addrlen);
+    if (dev->is_batching) {
+        if (out->batch_bytes_capacity - out->batch_size < size) {
+            Usz capacity = out->batch_bytes_capacity ? out->batch_bytes_capacity : 4096;
+            while (capacity - out->batch_size < size)
+                capacity *= 2;
+            out->batch_bytes = realloc(out->batch_bytes, capacity);
+            out->batch_bytes_capacity = capacity;
+        }
+        if (out->batch_count == out->batch_count_capacity) {
+            Usz capacity = out->batch_count_capacity ? out->batch_count_capacity * 2 : 64;
+            out->batch_ends = realloc(out->batch_ends, capacity * sizeof(Usz));
+            out->batch_count_capacity = capacity;
+        }
+        memcpy(out->batch_bytes + out->batch_size, data, size);
+        out->batch_size += size;
+        out->batch_ends[out->batch_count++] = out->batch_size;
+        return;
+    }
+    ssize_t res = sendto(out->fd, data, size, 0, out->chosen->ai_addr, out->chosen->ai_addrlen);
     (void)res;
     // TODO handle this in UI somehow
 #if 0
@@ -106,6 +377,109 @@ void oosc_send_datagram(Oosc_dev *dev, char const *data, Usz size)
 #endif
 }
 
+static void oosc_write_bundle_header(char *dest, U64 timetag)
+{
+    U32 tt[2] = { htonl((U32)(timetag >> 32)), htonl((U32)timetag) };
+    memcpy(dest, "#bundle", 8);
+    memcpy(dest + 8, tt, sizeof tt);
+}
+
+static void oosc_end_bundle(Oosc_dev const *dev, Oosc_out *out)
+{
+    oosc_out_send(dev, out, out->bundle, out->bundle_size);
+    out->bundle_size = 0;
+}
+
+// An element is a message with its size in front.
+static void oosc_add_to_bundle(Oosc_dev const *dev, Oosc_out *out, char const *element, Usz size)
+{
+    if (out->bundle_size + size > Oosc_bundle_max_size)
+        oosc_end_bundle(dev, out);
+    if (!out->bundle_size) {
+        if (!out->bundle)
+            out->bundle = malloc(Oosc_bundle_max_size);
+        // A timetag of 1 means right away.
+        oosc_write_bundle_header(out->bundle, dev->timetag ? dev->timetag : 1);
+        out->bundle_size = Oosc_bundle_header_size - sizeof(U32);
+    }
+    memcpy(out->bundle + out->bundle_size, element, size);
+    out->bundle_size += size;
+}
+
+static void oosc_out_flush(Oosc_dev const *dev, Oosc_out *out)
+{
+    if (out->bundle_size)
+        oosc_end_bundle(dev, out);
+    Usz count = out->batch_count;
+    if (count == 0)
+        return;
+    struct sockaddr *addr = out->chosen->ai_addr;
+    socklen_t addrlen = out->chosen->ai_addrlen;
+#ifdef FEAT_SENDMMSG
+    if (out->msgs_capacity < count) {
+        out->msgs = realloc(out->msgs, count * sizeof(struct mmsghdr));
+        out->iovs = realloc(out->iovs, count * sizeof(struct iovec));
+        out->msgs_capacity = count;
+    }
+    for (Usz i = 0, start = 0; i < count; start = out->batch_ends[i++]) {
+        out->iovs[i].iov_base = out->batch_bytes + start;
+        out->iovs[i].iov_len = out->batch_ends[i] - start;
+        struct msghdr *hdr = &out->msgs[i].msg_hdr;
+        memset(hdr, 0, sizeof(struct msghdr));
+        hdr->msg_name = addr;
+        hdr->msg_namelen = addrlen;
+        hdr->msg_iov = &out->iovs[i];
+        hdr->msg_iovlen = 1;
+    }
+    for (Usz sent = 0; sent < count;) {
+        int res = sendmmsg(out->fd, out->msgs + sent, (unsigned)(count - sent), 0);
+        // sendmmsg() stops at the first datagram that fails. Drop that one and
+        // go on with the rest, like separate sendto() calls would.
+        sent += res > 0 ? (Usz)res : 1;
+    }
+#else
+    for (Usz i = 0, start = 0; i < count; start = out->batch_ends[i++]) {
+        Usz size = out->batch_ends[i] - start;
+        ssize_t res = sendto(out->fd, out->batch_bytes + start, size, 0, addr, addrlen);
+        (void)res;
+    }
+#endif
+    out->batch_count = 0;
+    out->batch_size = 0;
+}
+
+void oosc_dev_flush(Oosc_dev *dev)
+{
+    // Still batching while the bundles go into the batches.
+    for (Usz i = 0; i < dev->out_count; ++i)
+        oosc_out_flush(dev, &dev->outs[i]);
+    dev->is_batching = false;
+}
+
+void oosc_dev_set_delay(Oosc_dev *dev, double secs)
+{
+    if (secs < 0.0) {
+        dev->timetag = 0;
+        return;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    double frac = (double)ts.tv_nsec * 1e-9 + secs;
+    U64 whole = (U64)frac;
+    // Seconds in the top 32 bits, and fractions of one in the bottom 32.
+    U64 ntp_secs = (U64)ts.tv_sec + OOSC_NTP_UNIX_OFFSET + whole;
+    dev->timetag = ntp_secs << 32 | (U64)((frac - (double)whole) * 4294967296.0);
+}
+
+void oosc_send_datagram(Oosc_dev *dev, char const *data, Usz size)
+{
+    for (Usz i = 0; i < dev->out_count; ++i) {
+        Oosc_out *out = &dev->outs[i];
+        if (out->kinds & Oosc_kind_udp)
+            oosc_out_send(dev, out, data, size);
+    }
+}
+
 static bool oosc_write_strn(
     char *restrict buffer,
     Usz buffer_size,
@@ -132,16 +506,21 @@ static bool oosc_write_strn(
     return true;
 }
 
-void oosc_send_int32s(Oosc_dev *dev, char const *osc_address, I32 const *vals, Usz count)
+// The address and typetag. Returns the size, or 0 if they don't fit.
+static Usz oosc_write_header(
+    char *restrict buffer,
+    Usz buffer_size,
+    char const *restrict osc_address,
+    Usz address_len,
+    Usz count)
 {
-    char buffer[2048];
     Usz buf_pos = 0;
-    if (!oosc_write_strn(buffer, sizeof(buffer), &buf_pos, osc_address, strlen(osc_address)))
-        return;
+    if (!oosc_write_strn(buffer, buffer_size, &buf_pos, osc_address, address_len))
+        return 0;
     Usz typetag_str_size = 1 + count + 1; // comma, 'i'... , null
     Usz typetag_str_null_pad = (4 - typetag_str_size % 4) % 4;
-    if (buf_pos + typetag_str_size + typetag_str_null_pad > sizeof(buffer))
-        return;
+    if (buf_pos + typetag_str_size + typetag_str_null_pad > buffer_size)
+        return 0;
     buffer[buf_pos] = ',';
     ++buf_pos;
     for (Usz i = 0; i < count; ++i) {
@@ -153,9 +532,72 @@ void oosc_send_int32s(Oosc_dev *dev, char const *osc_address, I32 const *vals, U
         buffer[buf_pos + i] = 0;
     }
     buf_pos += typetag_str_null_pad;
+    return buf_pos;
+}
+
+// NULL if the address is too long, or there are too many ints, to keep one.
+// Finds the length of the address on the way, for the caller.
+static Oosc_template const *oosc_template(
+    Oosc_dev *dev,
+    char const *osc_address,
+    Usz count,
+    Usz *out_len)
+{
+    U32 hash = 2166136261u ^ (U32)count; // FNV-1a
+    Usz len = 0;
+    for (; osc_address[len]; ++len) {
+        if (len == Oosc_template_address_max - 1) {
+            *out_len = len + strlen(osc_address + len);
+            return NULL;
+        }
+        hash = (hash ^ (U8)osc_address[len]) * 16777619u;
+    }
+    *out_len = len;
+    if (count > Oosc_template_ints_max)
+        return NULL;
+    Oosc_template *t = &dev->templates[hash & (Oosc_template_count - 1)];
+    if (t->count == count) {
+        Usz i = 0;
+        while (i < len && t->address[i] == osc_address[i])
+            ++i;
+        if (i == len && t->address[len] == '\0')
+            return t;
+    }
+    memcpy(t->address, osc_address, len + 1);
+    t->count = count;
+    t->header_size = oosc_write_header(t->header, sizeof t->header, osc_address, len, count);
+    return t;
+}
+
+Usz oosc_dev_encode_int32s(
+    Oosc_dev *dev,
+    char *out,
+    Usz out_size,
+    char const *osc_address,
+    I32 const *vals,
+    Usz count)
+{
+    Usz len;
+    Oosc_template const *t = oosc_template(dev, osc_address, count, &len);
+    Usz buf_pos;
+    if (t) {
+        buf_pos = t->header_size;
+        if (buf_pos > out_size)
+            return 0;
+        // Copying all of it, past the end of the header, is quicker than
+        // copying an amount that isn't known until now.
+        if (out_size >= sizeof t->header)
+            memcpy(out, t->header, sizeof t->header);
+        else
+            memcpy(out, t->header, buf_pos);
+    } else {
+        buf_pos = oosc_write_header(out, out_size, osc_address, len, count);
+        if (!buf_pos)
+            return 0;
+    }
     Usz ints_size = count * sizeof(I32);
-    if (buf_pos + ints_size > sizeof(buffer))
-        return;
+    if (buf_pos + ints_size > out_size)
+        return 0;
     for (Usz i = 0; i < count; ++i) {
         union {
             I32 i;
@@ -163,131 +605,192 @@ void oosc_send_int32s(Oosc_dev *dev, char const *osc_address, I32 const *vals, U
         } pun;
         pun.i = vals[i];
         U32 u_ne = htonl(pun.u);
-        memcpy(buffer + buf_pos, &u_ne, sizeof(u_ne));
+        memcpy(out + buf_pos, &u_ne, sizeof(u_ne));
         buf_pos += sizeof(u_ne);
     }
-    oosc_send_datagram(dev, buffer, buf_pos);
+    return buf_pos;
 }
 
-void susnote_list_init(Susnote_list *sl)
+void oosc_send_int32s(
+    Oosc_dev *dev,
+    Oosc_kind kind,
+    char const *osc_address,
+    I32 const *vals,
+    Usz count)
 {
-    sl->buffer = NULL;
-    sl->count = 0;
-    sl->capacity = 0;
+    if (!(dev->kinds & kind))
+        return;
+    char buffer[Oosc_message_max_size];
+    // Leave room in front for a bundle header, in case there's going to be
+    // one.
+    Usz msg_start = Oosc_bundle_header_size;
+    Usz buf_pos = msg_start + oosc_dev_encode_int32s(
+        dev,
+        buffer + msg_start,
+        sizeof(buffer) - msg_start,
+        osc_address,
+        vals,
+        count);
+    if (buf_pos == msg_start)
+        return;
+    // The message's size goes right in front of it, as a bundle element.
+    Usz elem_start = msg_start - sizeof(U32);
+    U32 msg_size = htonl((U32)(buf_pos - msg_start));
+    memcpy(buffer + elem_start, &msg_size, sizeof(U32));
+    bool to_bundle = dev->is_batching && dev->is_bundling;
+    if (!to_bundle && dev->timetag)
+        oosc_write_bundle_header(buffer, dev->timetag);
+    // Encoded once, for every destination that takes this kind.
+    for (Usz i = 0; i < dev->out_count; ++i) {
+        Oosc_out *out = &dev->outs[i];
+        if (!(out->kinds & kind))
+            continue;
+        if (to_bundle)
+            oosc_add_to_bundle(dev, out, buffer + elem_start, buf_pos - elem_start);
+        else if (!dev->timetag)
+            oosc_out_send(dev, out, buffer + msg_start, buf_pos - msg_start);
+        else
+            oosc_out_send(dev, out, buffer, buf_pos);
+    }
 }
 
-void susnote_list_deinit(Susnote_list *sl)
+static ORCA_FORCEINLINE Usz susnote_lowest_bit(U64 w)
 {
-    free(sl->buffer);
+#if defined(__GNUC__) || defined(__clang__)
+    return (Usz)__builtin_ctzll(w);
+#else
+    Usz i = 0;
+    while (!(w & 1)) {
+        w >>= 1;
+        ++i;
+    }
+    return i;
+#endif
 }
 
-void susnote_list_clear(Susnote_list *sl)
+void susnote_table_init(Susnote_table *st)
 {
-    sl->count = 0;
+    for (Usz i = 0; i < Susnote_wheel_size; ++i) {
+        st->wheel[0][i] = Susnote_count;
+        st->wheel[1][i] = Susnote_count;
+    }
+    memset(st->on, 0, sizeof st->on);
+    st->now = 0;
+    st->on_count = 0;
 }
 
-void susnote_list_add_notes(
-    Susnote_list *sl,
-    Susnote const *restrict notes,
-    Usz added_count,
-    Usz *restrict start_removed,
-    Usz *restrict end_removed)
+static U16 *susnote_bucket(Susnote_table *st, U32 deadline)
 {
-    Susnote *buffer = sl->buffer;
-    Usz count = sl->count;
-    Usz cap = sl->capacity;
-    Usz rem = count + added_count;
-    Usz needed_cap = rem + added_count;
-    if (cap < needed_cap) {
-        cap = needed_cap < 16 ? 16 : orca_round_up_power2(needed_cap);
-        buffer = realloc(buffer, cap * sizeof(Susnote));
-        sl->capacity = cap;
-        sl->buffer = buffer;
-    }
-    *start_removed = rem;
-    Usz i_in = 0;
-    for (; i_in < added_count; ++i_in) {
-        Susnote this_in = notes[i_in];
-        for (Usz i_old = 0; i_old < count; ++i_old) {
-            Susnote this_old = buffer[i_old];
-            if (this_old.chan_note == this_in.chan_note) {
-                buffer[i_old] = this_in;
-                buffer[rem] = this_old;
-                ++rem;
-                goto next_in;
-            }
-        }
-        buffer[count] = this_in;
-        ++count;
-    next_in:;
-    }
-    sl->count = count;
-    *end_removed = rem;
-}
-
-void susnote_list_advance_time(
-    Susnote_list *sl,
-    double delta_time,
-    Usz *restrict start_removed,
-    Usz *restrict end_removed,
-    double *soonest_deadline)
-{
-    Susnote *restrict buffer = sl->buffer;
-    Usz count = sl->count;
-    *end_removed = count;
-    float delta_float = (float)delta_time;
-    float soonest = 1.0f;
-    for (Usz i = 0; i < count;) {
-        Susnote sn = buffer[i];
-        sn.remaining -= delta_float;
-        if (sn.remaining > 0.001) {
-            if (sn.remaining < soonest)
-                soonest = sn.remaining;
-            buffer[i].remaining = sn.remaining;
-            ++i;
+    if (deadline >> Susnote_wheel_bits == st->now >> Susnote_wheel_bits)
+        return &st->wheel[0][deadline & (Susnote_wheel_size - 1)];
+    return &st->wheel[1][(deadline >> Susnote_wheel_bits) & (Susnote_wheel_size - 1)];
+}
+
+static void susnote_link(Susnote_table *st, U16 note, U32 deadline)
+{
+    Susnote_slot *slot = st->slots + note;
+    U16 *head = susnote_bucket(st, deadline);
+    slot->deadline = deadline;
+    slot->prev = Susnote_count;
+    slot->next = *head;
+    if (*head != Susnote_count)
+        st->slots[*head].prev = note;
+    *head = note;
+}
+
+static void susnote_unlink(Susnote_table *st, U16 note)
+{
+    Susnote_slot *slot = st->slots + note;
+    if (slot->prev != Susnote_count)
+        st->slots[slot->prev].next = slot->next;
+    else
+        *susnote_bucket(st, slot->deadline) = slot->next;
+    if (slot->next != Susnote_count)
+        st->slots[slot->next].prev = slot->prev;
+}
+
+static ORCA_FORCEINLINE bool susnote_is_on(Susnote_table const *st, Usz note)
+{
+    return st->on[note >> 7][(note >> 6) & 1] >> (note & 63) & 1;
+}
+
+static ORCA_FORCEINLINE void susnote_flip(Susnote_table *st, Usz note)
+{
+    st->on[note >> 7][(note >> 6) & 1] ^= (U64)1 << (note & 63);
+}
+
+Usz susnote_table_add_notes(Susnote_table *st, Susnote const *notes, Usz count)
+{
+    Usz offs = 0;
+    for (Usz i = 0; i < count; ++i) {
+        U16 note = notes[i].note;
+        Usz ticks = notes[i].ticks;
+        if (ticks < 1)
+            ticks = 1;
+        else if (ticks > Susnote_ticks_max)
+            ticks = Susnote_ticks_max;
+        if (susnote_is_on(st, note)) {
+            susnote_unlink(st, note);
+            st->offs[offs++] = note;
         } else {
-            --count;
-            buffer[i] = buffer[count];
-            buffer[count] = sn;
+            susnote_flip(st, note);
+            ++st->on_count;
         }
+        susnote_link(st, note, st->now + (U32)ticks);
     }
-    *start_removed = count;
-    *soonest_deadline = (double)soonest;
-    sl->count = count;
-}
-
-void susnote_list_remove_by_chan_mask(
-    Susnote_list *sl,
-    Usz chan_mask,
-    Usz *restrict start_removed,
-    Usz *restrict end_removed)
-{
-    Susnote *restrict buffer = sl->buffer;
-    Usz count = sl->count;
-    *end_removed = count;
-    for (Usz i = 0; i < count;) {
-        Susnote sn = buffer[i];
-        Usz chan = sn.chan_note >> 8;
-        if (chan_mask & 1u << chan) {
-            --count;
-            buffer[i] = buffer[count];
-            buffer[count] = sn;
-        } else {
-            ++i;
+    return offs;
+}
+
+Usz susnote_table_advance(Susnote_table *st)
+{
+    U32 now = ++st->now;
+    Usz wheel_mask = Susnote_wheel_size - 1;
+    if (!st->on_count)
+        return 0;
+    // At the start of a run of 64 ticks, the notes ending in it go from the
+    // bucket for the run to the buckets for its ticks.
+    if (!(now & wheel_mask)) {
+        U16 *run = &st->wheel[1][(now >> Susnote_wheel_bits) & wheel_mask];
+        U16 note = *run;
+        *run = Susnote_count;
+        while (note != Susnote_count) {
+            U16 next = st->slots[note].next;
+            susnote_link(st, note, st->slots[note].deadline);
+            note = next;
         }
     }
-    *start_removed = count;
-    sl->count = count;
+    U16 *due = &st->wheel[0][now & wheel_mask];
+    Usz offs = 0;
+    for (U16 note = *due; note != Susnote_count; note = st->slots[note].next) {
+        susnote_flip(st, note);
+        st->offs[offs++] = note;
+    }
+    *due = Susnote_count;
+    st->on_count -= offs;
+    return offs;
 }
 
-double susnote_list_soonest_deadline(Susnote_list const *sl)
+Usz susnote_table_remove_by_chan_mask(Susnote_table *st, Usz chan_mask)
 {
-    float soonest = 1.0f;
-    Susnote const *buffer = sl->buffer;
-    for (Usz i = 0, n = sl->count; i < n; ++i) {
-        float rem = buffer[i].remaining;
-        if (rem < soonest)
-            soonest = rem;
+    Usz offs = 0;
+    for (Usz chan = 0; chan < Susnote_chans; ++chan) {
+        if (!(chan_mask & 1u << chan))
+            continue;
+        for (Usz half = 0; half < Susnote_notes / 64; ++half) {
+            U64 bits = st->on[chan][half];
+            st->on[chan][half] = 0;
+            for (; bits; bits &= bits - 1) {
+                U16 note = (U16)(chan << 7 | half << 6 | susnote_lowest_bit(bits));
+                susnote_unlink(st, note);
+                st->offs[offs++] = note;
+            }
+        }
     }
-    return (double)soonest;
+    st->on_count -= offs;
+    return offs;
+}
+
+Usz susnote_table_remove_all(Susnote_table *st)
+{
+    return susnote_table_remove_by_chan_mask(st, (1u << Susnote_chans) - 1);
 }
@@ -8,54 +8,145 @@ typedef enum
     Oosc_udp_create_error_ok = 0,
     Oosc_udp_create_error_getaddrinfo_failed = 1,
     Oosc_udp_create_error_couldnt_open_socket = 2,
+    Oosc_udp_create_error_multicast_failed = 3,
 } Oosc_udp_create_error;
 
+// What's sent, so each destination can take only some of it.
+typedef enum
+{
+    Oosc_kind_osc = 1 << 0,  // OSC ints from '=', and the /orca/ control messages
+    Oosc_kind_udp = 1 << 1,  // Raw strings from ';'
+    Oosc_kind_midi = 1 << 2, // MIDI sent as OSC for Plogue Bidule
+    Oosc_kinds_all = Oosc_kind_osc | Oosc_kind_udp | Oosc_kind_midi,
+} Oosc_kind;
+
+typedef struct {
+    char const *addr; // Host name or address. NULL for loopback.
+    char const *port;
+    U8 kinds; // Oosc_kind bits of what it gets
+    // Only for multicast addresses. The TTL, or hop limit for IPv6, with 0
+    // leaving the system's default (1, the local network). The interface
+    // by name, or by address for IPv4, with NULL leaving it to the routing
+    // table.
+    int multicast_ttl;
+    char const *multicast_if;
+} Oosc_dest;
+
 // Susnote is for handling MIDI note sustains -- each MIDI on event should be
 // matched with a MIDI note-off event. The duration/sustain length of a MIDI
 // note is specified when it is first triggered, so the orca VM itself is not
-// responsible for sending the note-off event. We keep a list of currently 'on'
-// notes so that they can have a matching 'off' sent at the correct time.
+// responsible for sending the note-off event. We keep a table of currently
+// 'on' notes so that they can have a matching 'off' sent at the correct time.
+//
+// A note is its channel << 7 | its number, which is also its slot in the
+// table, so finding out whether it's already on takes no searching. How long
+// it's held is counted in ticks. The notes that are on hang off a timer wheel
+// by the tick they end on: 64 buckets for the ticks of the current run of 64,
+// and 64 more for the runs after that, which get spread over the first ones
+// as their run comes up. Ending the notes that are due then only touches
+// those notes.
+enum
+{
+    Susnote_chans = 16,
+    Susnote_notes = 128,
+    Susnote_count = Susnote_chans * Susnote_notes,
+    Susnote_wheel_bits = 6,
+    Susnote_wheel_size = 1 << Susnote_wheel_bits,
+    // Durations from the VM are 7 bits, well inside what the wheel covers.
+    Susnote_ticks_max = Susnote_wheel_size * (Susnote_wheel_size - 1),
+};
+
 typedef struct {
-    float remaining;
-    U16 chan_note;
+    U16 note; // channel << 7 | number
+    U16 ticks;
 } Susnote;
 
 typedef struct {
-    Susnote *buffer;
-    Usz count, capacity;
-} Susnote_list;
+    U16 next, prev; // In its wheel bucket, Susnote_count at the ends
+    U32 deadline;   // The tick it ends on
+} Susnote_slot;
 
+typedef struct {
+    Susnote_slot slots[Susnote_count];
+    U64 on[Susnote_chans][Susnote_notes / 64]; // Bits of the notes in the wheel
+    U16 wheel[2][Susnote_wheel_size];           // First slot in each bucket
+    U32 now;                                    // Ticks so far, wrapping around
+    Usz on_count;
+    // The functions that end notes put them here, from the start, and return
+    // how many.
+    U16 offs[Susnote_count];
+} Susnote_table;
+
+// A device with no destinations, which sends nothing until some are added.
+Oosc_dev *oosc_dev_create(void);
+// Everything sent to the device after this also goes to dest, if it's of
+// one of its kinds.
+Oosc_udp_create_error oosc_dev_add_udp(Oosc_dev *dev, Oosc_dest const *dest);
+// A device with just the one destination, which gets everything.
 Oosc_udp_create_error oosc_dev_create_udp(Oosc_dev **out_ptr, char const *dest_addr, char const *dest_port);
 void oosc_dev_destroy(Oosc_dev *dev);
 
-// Send a raw UDP datagram.
+// Parse a destination from the command line, which looks like
+//
+//   [host]:port[,only=osc+udp+midi][,ttl=N][,if=interface]
+//
+// with an IPv6 host in square brackets. Without only= it gets every kind.
+// Points into spec, which gets cut up. Returns false, and leaves spec alone,
+// if it doesn't parse.
+bool oosc_dest_parse(char *spec, Oosc_dest *out);
+
+// OSC messages sent after this are wrapped in a bundle, timetagged secs from
+// now, so the receiver can act on them at that time instead of whenever they
+// arrive. Less than 0 goes back to sending them on their own. Raw datagrams
+// are always sent as they are.
+void oosc_dev_set_delay(Oosc_dev *dev, double secs);
+
+// Datagrams sent after this are held, in order, until oosc_dev_flush() sends
+// them all at once. That's one system call for the lot where there's
+// sendmmsg() (see SENDMMSG_ENABLED in Makefile.conf), instead of one each.
+void oosc_dev_begin_batch(Oosc_dev *dev);
+void oosc_dev_flush(Oosc_dev *dev);
+
+// With bundling on, the OSC messages of a batch are sent in one bundle,
+// after the raw datagrams, so a receiver can act on all of them at once. Its
+// timetag is the one from oosc_dev_set_delay(), or "right away". A batch
+// with a lot of messages is split over more than one bundle.
+void oosc_dev_set_bundling(Oosc_dev *dev, bool bundling);
+
+// Send a raw UDP datagram, to the destinations that take Oosc_kind_udp.
 void oosc_send_datagram(Oosc_dev *dev, char const *data, Usz size);
 
 // Send a list/array of 32-bit integers in OSC format to the specified "osc
-// address" (a path like /foo) as a UDP datagram.
-void oosc_send_int32s(Oosc_dev *dev, char const *osc_address, I32 const *vals, Usz count);
-
-void susnote_list_init(Susnote_list *sl);
-void susnote_list_deinit(Susnote_list *sl);
-void susnote_list_clear(Susnote_list *sl);
-void susnote_list_add_notes(
-    Susnote_list *sl,
-    Susnote const *restrict notes,
-    Usz count,
-    Usz *restrict start_removed,
-    Usz *restrict end_removed);
-void susnote_list_advance_time(
-    Susnote_list *sl,
-    double delta_time,
-    Usz *restrict start_removed,
-    Usz *restrict end_removed,
-    // 1.0 if no notes remain or none are shorter than 1.0
-    double *soonest_deadline);
-void susnote_list_remove_by_chan_mask(
-    Susnote_list *sl,
-    Usz chan_mask,
-    Usz *restrict start_removed,
-    Usz *restrict end_removed);
-
-// Returns 1.0 if no notes remain or none are shorter than 1.0
-double susnote_list_soonest_deadline(Susnote_list const *sl);
+// address" (a path like /foo) as a UDP datagram, to the destinations that
+// take kind.
+void oosc_send_int32s(
+    Oosc_dev *dev,
+    Oosc_kind kind,
+    char const *osc_address,
+    I32 const *vals,
+    Usz count);
+
+// Write the message oosc_send_int32s() would send to out, without sending it.
+// Returns its size, or 0 if it doesn't fit in out_size. What's in out past
+// the size can be overwritten too. The device keeps the address and typetag
+// part of recent messages, so usually only the ints get written from
+// scratch.
+Usz oosc_dev_encode_int32s(
+    Oosc_dev *dev,
+    char *out,
+    Usz out_size,
+    char const *osc_address,
+    I32 const *vals,
+    Usz count);
+
+void susnote_table_init(Susnote_table *st);
+// Turn the notes on, to end after their ticks (at least 1) have passed. A
+// note that was already on is ended first, and the notes that were are in
+// offs.
+Usz susnote_table_add_notes(Susnote_table *st, Susnote const *notes, Usz count);
+// One tick passes. The notes it was the end of are in offs.
+Usz susnote_table_advance(Susnote_table *st);
+// End the notes on the channels with their bit set in chan_mask.
+Usz susnote_table_remove_by_chan_mask(Susnote_table *st, Usz chan_mask);
+// End all of them.
+Usz susnote_table_remove_all(Susnote_table *st);
@@ -0,0 +1,67 @@
+#include "output.h"
+
+// The count notes a susnote_table function just put in offs.
+static void output_note_offs(Output_sink const *sink, Susnote_table const *susnotes, Usz count)
+{
+    for (Usz i = 0; i < count; ++i) {
+        U16 note = susnotes->offs[i];
+        sink->midi(sink->userdata, (U8)(0x80 | note >> 7), (U8)(note & 0x7F), 0);
+    }
+}
+
+void output_events(
+    Output_sink const *sink,
+    Susnote_table *susnotes,
+    Oevent_list const *oevent_list)
+{
+    for (Oevent const *e = oevent_list_begin(oevent_list), *end = oevent_list_end(oevent_list);
+         e != end;
+         e = oevent_next(e)) {
+        switch ((Oevent_types)e->any.oevent_type) {
+            case Oevent_type_midi_note: {
+                Oevent_midi_note const *em = &e->midi_note;
+                Usz channel = em->channel;
+                if (channel > 15)
+                    break;
+                Usz number = (Usz)(12u * em->octave + em->note);
+                if (number > 127)
+                    number = 127;
+                if (em->mono)
+                    output_note_offs(
+                        sink,
+                        susnotes,
+                        susnote_table_remove_by_chan_mask(susnotes, (Usz)1 << channel));
+                Susnote sn = { .note = (U16)(channel << 7 | number), .ticks = em->duration };
+                output_note_offs(sink, susnotes, susnote_table_add_notes(susnotes, &sn, 1));
+                sink->midi(sink->userdata, (U8)(0x90 | channel), (U8)number, em->velocity);
+                break;
+            }
+            case Oevent_type_midi_cc: {
+                Oevent_midi_cc const *ec = &e->midi_cc;
+                sink->midi(sink->userdata, (U8)(0xB0 | ec->channel), ec->control, ec->value);
+                break;
+            }
+            case Oevent_type_midi_pb: {
+                Oevent_midi_pb const *ep = &e->midi_pb;
+                sink->midi(sink->userdata, (U8)(0xE0 | ep->channel), ep->lsb, ep->msb);
+                break;
+            }
+            case Oevent_type_osc_ints: {
+                Oevent_osc_ints const *eo = &e->osc_ints;
+                char path[] = { '/', eo->glyph, '\0' };
+                I32 ints[Oevent_osc_int_count];
+                Usz nnum = eo->count;
+                for (Usz inum = 0; inum < nnum; ++inum) {
+                    ints[inum] = eo->numbers[inum];
+                }
+                sink->osc_ints(sink->userdata, path, ints, nnum);
+                break;
+            }
+            case Oevent_type_udp_string: {
+                Oevent_udp_string const *eo = &e->udp_string;
+                sink->datagram(sink->userdata, eo->chars, eo->count);
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "base.h"
+#include "osc_out.h" // Susnote_table
+#include "vmio.h"
+
+// Turns the events of a tick into the MIDI, OSC and UDP messages that go out
+// for them, and keeps track of the sustained notes they start. It doesn't
+// send anything itself: the messages are handed to an Output_sink, which for
+// playback is send_output_events() (see player.h) passing them on to the
+// Oosc_dev and Midi_mode, and in tests is whatever records them.
+//
+// The events are handled in one pass, in the order the VM put them out, so a
+// CC between two notes goes out between them. A note that's already on is
+// ended right before it's started again. A mono note first ends everything
+// that's on on its channel at that point, including notes from earlier in the
+// same tick.
+
+typedef struct {
+    // A MIDI channel message: status is the type in the high 4 bits, and the
+    // channel in the low 4.
+    void (*midi)(void *userdata, U8 status, U8 byte1, U8 byte2);
+    void (*osc_ints)(void *userdata, char const *osc_address, I32 const *vals, Usz count);
+    void (*datagram)(void *userdata, char const *data, Usz size);
+    void *userdata;
+} Output_sink;
+
+void output_events(
+    Output_sink const *sink,
+    Susnote_table *susnotes,
+    Oevent_list const *oevent_list);
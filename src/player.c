@@ -0,0 +1,345 @@
+#include "player.h"
+#include "output.h"
+#include "sokol_time.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+void play_clock_init(Play_clock *pc)
+{
+    pc->clock = 0;
+    pc->accum_secs = 0.0;
+    pc->midi_bclock_sixths = 0;
+}
+
+static double play_step_secs(Usz bpm, bool midi_bclock)
+{
+    double secs_span = 60.0 / (double)bpm / 4.0;
+    // If MIDI beat clock output is enabled, we need to send an event every 24
+    // parts per quarter note. Since we've already divided quarter notes into 4
+    // for ORCA's timing semantics, divide it by a further 6.
+    if (midi_bclock)
+        secs_span /= 6.0;
+    return secs_span;
+}
+
+void play_clock_start(
+    Play_clock *pc,
+    Usz bpm,
+    bool midi_bclock,
+    Oosc_dev *oosc_dev,
+    Midi_mode const *midi_mode)
+{
+    pc->clock = stm_now();
+    pc->midi_bclock_sixths = 0;
+    // dumb'n'dirty, get us close to the next step time, but not quite
+    pc->accum_secs = play_step_secs(bpm, midi_bclock) - 0.0001;
+    if (midi_bclock)
+        send_midi_byte(oosc_dev, midi_mode, 0xFA); // "start"
+    send_control_message(oosc_dev, "/orca/started");
+}
+
+void play_clock_stop(
+    bool midi_bclock,
+    Oosc_dev *oosc_dev,
+    Midi_mode *midi_mode,
+    Susnote_table *susnotes)
+{
+    play_stop_all_sustained_notes(oosc_dev, midi_mode, susnotes);
+    send_control_message(oosc_dev, "/orca/stopped");
+    if (midi_bclock)
+        send_midi_byte(oosc_dev, midi_mode, 0xFC); // "stop"
+}
+
+void play_stop_all_sustained_notes(
+    Oosc_dev *oosc_dev,
+    Midi_mode *midi_mode,
+    Susnote_table *susnotes)
+{
+    Usz offs = susnote_table_remove_all(susnotes);
+    send_midi_note_offs(oosc_dev, midi_mode, susnotes->offs, offs);
+}
+
+U64 play_clock_step_due(Play_clock const *pc, Usz bpm, bool midi_bclock)
+{
+    // The last step ran accum_secs late, so the next one is due that much
+    // sooner after it. stm_now() ticks are nanoseconds.
+    double secs = play_step_secs(bpm, midi_bclock) - pc->accum_secs;
+    if (secs < 0.0)
+        secs = 0.0;
+    return pc->clock + (U64)(secs * 1e9);
+}
+
+void play_clock_output_at_step(
+    Play_clock const *pc,
+    Usz lookahead_ms,
+    Oosc_dev *oosc_dev,
+    Midi_mode *midi_mode)
+{
+    if (!lookahead_ms)
+        return;
+    // The step was due accum_secs before pc->clock. If it's running later
+    // than the lookahead, the best that can be done is right away.
+    double secs = ms_to_sec((double)lookahead_ms) - pc->accum_secs - stm_sec(stm_since(pc->clock));
+    if (secs < 0.0)
+        secs = 0.0;
+    if (oosc_dev)
+        oosc_dev_set_delay(oosc_dev, secs);
+    midi_mode_set_delay(midi_mode, secs);
+}
+
+void play_output_now(Oosc_dev *oosc_dev, Midi_mode *midi_mode)
+{
+    if (oosc_dev)
+        oosc_dev_set_delay(oosc_dev, -1.0);
+    midi_mode_set_delay(midi_mode, -1.0);
+}
+
+bool play_clock_step(
+    Play_clock *pc,
+    Usz bpm,
+    bool midi_bclock,
+    Usz lookahead_ms,
+    Oosc_dev *oosc_dev,
+    Midi_mode *midi_mode,
+    Susnote_table *susnotes)
+{
+    double secs_span = play_step_secs(bpm, midi_bclock);
+    bool crossed_deadline = false;
+#if TIME_DEBUG
+    Usz spins = 0;
+    U64 spin_start = stm_now();
+#endif
+    for (;;) {
+        U64 now = stm_now();
+        U64 diff = stm_diff(now, pc->clock);
+        double sdiff = stm_sec(diff) + pc->accum_secs;
+        if (sdiff >= secs_span) {
+            pc->clock = now;
+            pc->accum_secs = sdiff - secs_span;
+#if TIME_DEBUG
+            if (pc->accum_secs > 0.000001)
+                fprintf(stderr, "late: %.2f u-secs\n", pc->accum_secs * 1000 * 1000);
+#endif
+            crossed_deadline = true;
+            break;
+        }
+        if (secs_span - sdiff > ms_to_sec(0.1))
+            break;
+#if TIME_DEBUG
+        ++spins;
+#endif
+    }
+#if TIME_DEBUG
+    if (spins > 0)
+        fprintf(stderr, "%d spins in %f us\n", (int)spins, stm_us(stm_since(spin_start)));
+#endif
+    if (!crossed_deadline)
+        return false;
+    play_clock_output_at_step(pc, lookahead_ms, oosc_dev, midi_mode);
+    bool is_tick = true;
+    if (midi_bclock) {
+        send_midi_byte(oosc_dev, midi_mode, 0xF8); // MIDI beat clock
+        Usz sixths = pc->midi_bclock_sixths;
+        pc->midi_bclock_sixths = (U8)((sixths + 1) % 6);
+        is_tick = sixths == 0;
+    }
+    if (is_tick) {
+        Usz offs = susnote_table_advance(susnotes);
+        if (ORCA_UNLIKELY(offs > 0))
+            send_midi_note_offs(oosc_dev, midi_mode, susnotes->offs, offs);
+    }
+    if (lookahead_ms)
+        play_output_now(oosc_dev, midi_mode);
+    return is_tick;
+}
+
+typedef struct {
+    Oosc_dev *oosc_dev;
+    Midi_mode *midi_mode;
+} Play_sink;
+
+static void play_sink_midi(void *userdata, U8 status, U8 byte1, U8 byte2)
+{
+    Play_sink *ps = userdata;
+    send_midi_chan_msg(ps->oosc_dev, ps->midi_mode, status >> 4, status & 0xF, byte1, byte2);
+}
+
+static void play_sink_osc_ints(void *userdata, char const *osc_address, I32 const *vals, Usz count)
+{
+    Play_sink *ps = userdata;
+    if (ps->oosc_dev)
+        oosc_send_int32s(ps->oosc_dev, Oosc_kind_osc, osc_address, vals, count);
+}
+
+static void play_sink_datagram(void *userdata, char const *data, Usz size)
+{
+    Play_sink *ps = userdata;
+    if (ps->oosc_dev)
+        oosc_send_datagram(ps->oosc_dev, data, size);
+}
+
+void send_output_events(
+    Oosc_dev *oosc_dev,
+    Midi_mode *midi_mode,
+    Susnote_table *susnotes,
+    Oevent_list const *oevent_list)
+{
+    Play_sink ps = { .oosc_dev = oosc_dev, .midi_mode = midi_mode };
+    Output_sink sink = {
+        .midi = play_sink_midi,
+        .osc_ints = play_sink_osc_ints,
+        .datagram = play_sink_datagram,
+        .userdata = &ps,
+    };
+    // Everything for the network goes out together at the end.
+    if (oosc_dev)
+        oosc_dev_begin_batch(oosc_dev);
+    output_events(&sink, susnotes, oevent_list);
+    if (oosc_dev)
+        oosc_dev_flush(oosc_dev);
+}
+
+void play_sleep_until(U64 due)
+{
+    struct timespec ts;
+#ifdef __APPLE__
+    // No clock_nanosleep(), so this is as close as it gets.
+    U64 now = stm_now();
+    if (due <= now)
+        return;
+    ts.tv_sec = (time_t)((due - now) / 1000000000);
+    ts.tv_nsec = (long)((due - now) % 1000000000);
+    nanosleep(&ts, NULL);
+#else
+    // stm_now() is CLOCK_MONOTONIC less where it started. Reading both at
+    // once gives the deadline on CLOCK_MONOTONIC.
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    U64 now = stm_now();
+    if (due <= now)
+        return;
+    U64 ns = (U64)ts.tv_nsec + (due - now);
+    ts.tv_sec += (time_t)(ns / 1000000000);
+    ts.tv_nsec = (long)(ns % 1000000000);
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+#endif
+}
+
+struct Play_ticker {
+    Play_ticker_fns fns;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t poked;
+    int wake_fds[2]; // Read end, write end
+    bool strict_timing, quit;
+};
+
+static void *play_ticker_main(void *arg)
+{
+    Play_ticker *pt = arg;
+    // In stm_now() ticks, which are nanoseconds
+    U64 spin = pt->strict_timing ? 100000 : 0, max_sleep = 50000000;
+    pthread_mutex_lock(&pt->lock);
+    while (!pt->quit) {
+        U64 due;
+        if (!pt->fns.step_due(pt->fns.userdata, &due)) {
+            pthread_cond_wait(&pt->poked, &pt->lock);
+            continue;
+        }
+        U64 now = stm_now();
+        if (due > now + spin) {
+            U64 wake = due - spin;
+            if (wake > now + max_sleep)
+                wake = now + max_sleep;
+            pthread_mutex_unlock(&pt->lock);
+            play_sleep_until(wake);
+            pthread_mutex_lock(&pt->lock);
+            continue;
+        }
+        if (pt->fns.step(pt->fns.userdata)) {
+            char c = 0;
+            // If the pipe is full, the other side has a wake waiting already.
+            ssize_t written = write(pt->wake_fds[1], &c, 1);
+            (void)written;
+        }
+    }
+    pthread_mutex_unlock(&pt->lock);
+    return NULL;
+}
+
+Play_ticker *play_ticker_create(Play_ticker_fns fns, bool strict_timing)
+{
+    Play_ticker *pt = malloc(sizeof(Play_ticker));
+    if (!pt)
+        return NULL;
+    pt->fns = fns;
+    pt->strict_timing = strict_timing;
+    pt->quit = false;
+    if (pipe(pt->wake_fds)) {
+        free(pt);
+        return NULL;
+    }
+    for (int i = 0; i < 2; ++i)
+        fcntl(pt->wake_fds[i], F_SETFL, fcntl(pt->wake_fds[i], F_GETFL) | O_NONBLOCK);
+    pthread_mutex_init(&pt->lock, NULL);
+    pthread_cond_init(&pt->poked, NULL);
+    // The thread starts with signals blocked, so they keep going to the
+    // thread that expects them, like curses' SIGWINCH.
+    sigset_t all, prev;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &prev);
+    int err = pthread_create(&pt->thread, NULL, play_ticker_main, pt);
+    pthread_sigmask(SIG_SETMASK, &prev, NULL);
+    if (err) {
+        pthread_cond_destroy(&pt->poked);
+        pthread_mutex_destroy(&pt->lock);
+        close(pt->wake_fds[0]);
+        close(pt->wake_fds[1]);
+        free(pt);
+        return NULL;
+    }
+    return pt;
+}
+
+void play_ticker_destroy(Play_ticker *pt)
+{
+    pthread_mutex_lock(&pt->lock);
+    pt->quit = true;
+    pthread_cond_signal(&pt->poked);
+    pthread_mutex_unlock(&pt->lock);
+    pthread_join(pt->thread, NULL);
+    pthread_cond_destroy(&pt->poked);
+    pthread_mutex_destroy(&pt->lock);
+    close(pt->wake_fds[0]);
+    close(pt->wake_fds[1]);
+    free(pt);
+}
+
+void play_ticker_lock(Play_ticker *pt)
+{
+    pthread_mutex_lock(&pt->lock);
+}
+
+void play_ticker_unlock(Play_ticker *pt)
+{
+    pthread_mutex_unlock(&pt->lock);
+}
+
+void play_ticker_poke(Play_ticker *pt)
+{
+    pthread_cond_signal(&pt->poked);
+}
+
+int play_ticker_wake_fd(Play_ticker const *pt)
+{
+    return pt->wake_fds[0];
+}
+
+void play_ticker_clear_wake(Play_ticker *pt)
+{
+    char buf[64];
+    while (read(pt->wake_fds[0], buf, sizeof buf) > 0) {
+    }
+}
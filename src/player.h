@@ -0,0 +1,131 @@
+#pragma once
+#include "base.h"
+#include "vmio.h"
+#include "midi.h"
+#include "osc_out.h"
+
+// Real-time playback: when the next step is due, and what gets sent out at
+// each one. Ged plays through this from the TUI's event loop, and the
+// headless player (main_play.c) from its own, so both keep the same time and
+// send the same things. Nothing in here draws, or needs curses.
+//
+// Steps are 1/4 of a beat at the given BPM. With MIDI beat clock on, they're
+// cut into 6 further, because the clock ticks 24 times per beat, and the VM
+// only runs on every 6th.
+//
+// With a lookahead, what a step sends is timestamped to be played that many
+// milliseconds after the step was due: PortMidi holds it until then, and OSC
+// goes out in bundles with that timetag. How late the step actually ran, up
+// to the lookahead, then doesn't show in the output.
+
+typedef struct {
+    U64 clock;             // stm_now() at the last step
+    double accum_secs;     // How late the last step was
+    U8 midi_bclock_sixths; // 0..5, holds 6th of the quarter note step
+} Play_clock;
+
+void play_clock_init(Play_clock *pc);
+
+// Set the clock so the first step comes right away, and tell whatever is
+// listening that playback started.
+void play_clock_start(
+    Play_clock *pc,
+    Usz bpm,
+    bool midi_bclock,
+    Oosc_dev *oosc_dev,
+    Midi_mode const *midi_mode);
+
+// End the sustained notes, and tell whatever is listening that playback
+// stopped.
+void play_clock_stop(
+    bool midi_bclock,
+    Oosc_dev *oosc_dev,
+    Midi_mode *midi_mode,
+    Susnote_table *susnotes);
+
+void play_stop_all_sustained_notes(
+    Oosc_dev *oosc_dev,
+    Midi_mode *midi_mode,
+    Susnote_table *susnotes);
+
+// When the next step is due, in stm_now() ticks.
+U64 play_clock_step_due(Play_clock const *pc, Usz bpm, bool midi_bclock);
+
+// If a step is due, or less than 0.1 ms away (in which case this spins until
+// it is), send the MIDI beat clock, and return whether the VM should run a
+// tick now. If it should, a tick passes for the sustained notes first, and
+// the ones that are done get ended. The caller then runs the tick and hands
+// its events to send_output_events(), between play_clock_output_at_step()
+// and play_output_now().
+bool play_clock_step(
+    Play_clock *pc,
+    Usz bpm,
+    bool midi_bclock,
+    Usz lookahead_ms,
+    Oosc_dev *oosc_dev,
+    Midi_mode *midi_mode,
+    Susnote_table *susnotes);
+
+// With lookahead_ms, timestamp what's sent from here until play_output_now()
+// to be played lookahead_ms after the last step was due. Without, does
+// nothing.
+void play_clock_output_at_step(
+    Play_clock const *pc,
+    Usz lookahead_ms,
+    Oosc_dev *oosc_dev,
+    Midi_mode *midi_mode);
+
+void play_output_now(Oosc_dev *oosc_dev, Midi_mode *midi_mode);
+
+// Send what a tick's events put out (see output_events() in output.h) to the
+// Oosc_dev, which may be NULL, and the MIDI output, in one batch.
+void send_output_events(
+    Oosc_dev *oosc_dev,
+    Midi_mode *midi_mode,
+    Susnote_table *susnotes,
+    Oevent_list const *oevent_list);
+
+// Sleep until due, in stm_now() ticks, which count from a point on
+// CLOCK_MONOTONIC. It sleeps to the matching time on that clock, so it wakes
+// when due is, however long it took to get here. Returns early if a signal
+// arrives.
+void play_sleep_until(U64 due);
+
+// Runs the steps on a thread of its own, so the time the caller's thread
+// spends drawing or handling input doesn't move them. Between steps it sleeps
+// with play_sleep_until() to when the next one is due, for at most 50 ms at a
+// time so a change in tempo takes effect soon. Signals are blocked on its
+// thread.
+//
+// The callbacks run on that thread with the ticker's lock held. Anything
+// they touch must only be touched elsewhere with the lock held too. step()
+// can let go of it around work on things only its thread touches, like a
+// tick on a copy of the grid, as long as it holds it again before returning.
+typedef struct Play_ticker Play_ticker;
+
+typedef struct {
+    // If something is playing, sets due to when step() should be called (see
+    // play_clock_step_due()) and returns true. If not, the ticker waits for
+    // play_ticker_poke().
+    bool (*step_due)(void *userdata, U64 *due);
+    // Do what's due, which with strict_timing can be up to 0.1 ms away (see
+    // play_clock_step()). Returns true if a tick ran.
+    bool (*step)(void *userdata);
+    void *userdata;
+} Play_ticker_fns;
+
+// With strict_timing, the ticker wakes 0.1 ms before each step and spins
+// through the rest, for less jitter at the cost of some CPU. Returns NULL if
+// the thread couldn't be started.
+Play_ticker *play_ticker_create(Play_ticker_fns fns, bool strict_timing);
+void play_ticker_destroy(Play_ticker *pt);
+
+void play_ticker_lock(Play_ticker *pt);
+void play_ticker_unlock(Play_ticker *pt);
+// With the lock held: wake the ticker up to call step_due() again, after
+// playback starts.
+void play_ticker_poke(Play_ticker *pt);
+
+// Becomes readable for poll() after each tick, until play_ticker_clear_wake().
+int play_ticker_wake_fd(Play_ticker const *pt);
+void play_ticker_clear_wake(Play_ticker *pt);
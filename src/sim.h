@@ -1,12 +1,166 @@
 #pragma once
 #include "base.h"
+#include "cfield.h"
 #include "vmio.h"
 
+// A compiled form of a grid, kept from one tick to the next: for each row,
+// the columns of the cells holding an operator glyph, in the order they run.
+// With one of these, orca_run() walks the lists instead of searching the grid
+// for cells to run, and never looks at the cells holding '.' or numbers. The
+// VM notes each cell where it writes or erases an operator, and patches those
+// into the program at the start of the next run.
+// Code that edits the grid in place must report what it touched the same
+// way, with oprog_mark_subrect(), and code that replaces it wholesale calls
+// oprog_invalidate(). A change of grid dimensions, or more changes than the
+// list has room for, recompiles everything.
+
+typedef struct {
+    U16 *cols;
+    Usz count, capacity;
+} Oprog_row;
+
+typedef struct {
+    Oprog_row *rows;
+    Usz rows_capacity;
+    U32 *changes; // Offsets of cells changed since the program was last brought up to date
+    Usz change_count, change_capacity;
+    Usz height, width;
+    bool is_valid;
+} Oprog;
+
+void oprog_init(Oprog *prog);
+void oprog_invalidate(Oprog *prog);
+void oprog_mark_subrect(Oprog *prog, Usz y, Usz x, Usz height, Usz width);
+void oprog_deinit(Oprog *prog);
+
+// How a tick's result depended on its tick number. Bit n of periods is set
+// when some operator's output depended on the tick number modulo n (C, D and
+// U), and aperiodic when one used it in a way with no useful period (R). So
+// the same grid run with another tick number that is congruent modulo every
+// period in here gives the same result, unless aperiodic is set. Left alone
+// by the run otherwise, so clear it first.
+
+enum
+{
+    Otick_period_max = 35 * 35 // The longest C or D can have
+};
+
+typedef struct {
+    U64 periods[Otick_period_max / 64 + 1];
+    bool aperiodic;
+} Otick_deps;
+
+// obuffer holds occupancy bitmaps for gbuffer (see obuffer_* in gbuffer.h),
+// which lets the VM skip empty cells without reading them. It is kept up to
+// date by the VM as it writes. Pass NULL to scan every cell instead.
+//
+// prog, if not NULL, is brought up to date and then used in place of scanning
+// (see Oprog above). obuffer is still kept up to date if given, and makes
+// recompiling a row cheaper.
+//
+// mdirty is the dirty map for mbuffer (see mbuffer_dirty_* in gbuffer.h). The
+// VM records every mark it writes in it, so it must cover at least
+// height * width marks.
+//
+// tick_deps, if not NULL, gets what the tick did with tick_number added to
+// it (see Otick_deps above).
 void orca_run(
     Glyph *restrict gbuffer,
     Mark *restrict mbuffer,
+    U8 *mdirty,
+    Occword *obuffer,
+    Oprog *prog,
     Usz height,
     Usz width,
     Usz tick_number,
     Oevent_list *oevent_list,
-    Usz random_seed);
+    Usz random_seed,
+    Otick_deps *tick_deps);
+
+// A pool of threads for running ticks in parallel with orca_run_par().
+typedef struct Opar Opar;
+
+// thread_count includes the calling thread, so 1 starts no threads at all.
+Opar *opar_create(Usz thread_count);
+void opar_destroy(Opar *par);
+
+// Same as orca_run(), with the same result down to the last glyph, mark and
+// event, but spread over par's threads. prog must not be NULL. The marks must
+// have been cleared before the tick, as they are for orca_run() by everything
+// in this repo; a part of the grid where they weren't gets run serially.
+//
+// The grid is split into bands of whole rows, cut only where no operator can
+// reach across (going by OPERATOR_REACHES in sim.c), so bands never touch
+// each other's cells and can run at the same time. Bands holding V or K share
+// the variable slots, so no two of those run together. A J chain that grows
+// during a tick can still walk out of its band; that gets noticed before the
+// walk leaves, the bands running alongside it are undone, and they're run
+// again serially.
+void orca_run_par(
+    Opar *par,
+    Glyph *restrict gbuffer,
+    Mark *restrict mbuffer,
+    U8 *mdirty,
+    Occword *obuffer,
+    Oprog *prog,
+    Usz height,
+    Usz width,
+    Usz tick_number,
+    Oevent_list *oevent_list,
+    Usz random_seed,
+    Otick_deps *tick_deps);
+
+// Scratch space for orca_run_cfield(), kept from one tick to the next so it
+// doesn't get allocated again every time.
+typedef struct Oislands Oislands;
+
+Oislands *oislands_create(void);
+void oislands_destroy(Oislands *islands);
+
+// Runs a tick on a chunked grid (see cfield.h), with the same resulting glyphs
+// and events as orca_run() on the same grid stored densely. Marks aren't kept
+// between ticks, so they start out clear every time.
+//
+// Only the parts of the grid with operators in them get run, as islands:
+// rectangles around groups of chunks, each big enough to hold everything
+// their operators can reach (going by OPERATOR_REACHES in sim.c), and apart
+// from every other island. Each island is copied into a dense buffer, run,
+// and copied back. Islands side by side are run a row at a time, taking turns
+// from left to right, so shared things like the variable slots and the order
+// of events come out the same as in one pass over the whole grid.
+void orca_run_cfield(
+    Oislands *islands,
+    Cfield *cfield,
+    Usz tick_number,
+    Oevent_list *oevent_list,
+    Usz random_seed,
+    Otick_deps *tick_deps);
+
+#ifdef FEAT_PROFILE
+// Per-operator counters, only in builds with FEAT_PROFILE (PROFILE_ENABLED=1
+// in build.conf). Every run adds to the same totals, indexed by the glyph
+// that ran: how many times it ran, how many of those stopped at
+// LOWERCASE_REQUIRES_BANG or STOP_IF_NOT_BANGED, and the time spent in it.
+// Time is in TSC ticks on x86, and nanoseconds elsewhere. Nothing here is
+// thread safe, so a program that runs the VM on more than one thread points
+// them elsewhere with orca_profile_into().
+
+typedef struct {
+    U64 calls, early_exits, time;
+} Oprof_glyph;
+
+typedef struct {
+    Oprof_glyph glyphs[128];
+} Oprof;
+
+Oprof const *orca_profile(void);
+void orca_profile_reset(void);
+// Runs on the calling thread count into prof from now on, or not at all if
+// it's NULL. Threads start out counting into the totals.
+void orca_profile_into(Oprof *prof);
+// Adds prof to the totals, and zeroes it.
+void orca_profile_collect(Oprof *prof);
+// Fills glyphs with every glyph that has run, most time first, and returns
+// how many there are. glyphs needs room for 128.
+Usz orca_profile_sorted(Oprof const *prof, Glyph *glyphs);
+#endif
@@ -0,0 +1,122 @@
+#include "smf.h"
+
+void smf_init(Smf *smf)
+{
+    smf->events = NULL;
+    smf->count = 0;
+    smf->capacity = 0;
+    smf->chan_mask = 0;
+}
+
+void smf_deinit(Smf *smf)
+{
+    free(smf->events);
+}
+
+void smf_add(Smf *smf, Usz tick, U8 status, U8 byte1, U8 byte2)
+{
+    assert(!smf->count || smf->events[smf->count - 1].tick <= tick);
+    if (smf->count == smf->capacity) {
+        Usz capacity = smf->capacity ? smf->capacity * 2 : 1024;
+        smf->events = realloc(smf->events, capacity * sizeof(Smf_event));
+        smf->capacity = capacity;
+    }
+    smf->events[smf->count++] = (Smf_event){ (U32)tick, status, byte1, byte2 };
+    smf->chan_mask |= (U16)(1u << (status & 0xF));
+}
+
+// A track's bytes, before they go in their chunk.
+typedef struct {
+    U8 *bytes;
+    Usz size, capacity;
+} Smf_buf;
+
+static void smf_buf_put(Smf_buf *buf, U8 const *data, Usz size)
+{
+    if (buf->capacity - buf->size < size) {
+        Usz capacity = buf->capacity ? buf->capacity : 4096;
+        while (capacity - buf->size < size)
+            capacity *= 2;
+        buf->bytes = realloc(buf->bytes, capacity);
+        buf->capacity = capacity;
+    }
+    memcpy(buf->bytes + buf->size, data, size);
+    buf->size += size;
+}
+
+// Delta times are variable length: 7 bits per byte, most significant first,
+// with the top bit set on all but the last.
+static void smf_buf_put_delta(Smf_buf *buf, U32 ticks)
+{
+    U8 bytes[4];
+    Usz n = 0;
+    do {
+        bytes[3 - n++] = (U8)(ticks & 0x7F);
+        ticks >>= 7;
+    } while (ticks && n < 4);
+    for (Usz i = 4 - n; i < 3; ++i)
+        bytes[i] |= 0x80;
+    smf_buf_put(buf, bytes + 4 - n, n);
+}
+
+static void smf_buf_put_end(Smf_buf *buf, U32 ticks)
+{
+    smf_buf_put_delta(buf, ticks);
+    smf_buf_put(buf, (U8 const[]){ 0xFF, 0x2F, 0x00 }, 3);
+}
+
+static bool smf_write_chunk(FILE *file, char const *type, U8 const *data, Usz size)
+{
+    U8 len[4] = { (U8)(size >> 24), (U8)(size >> 16), (U8)(size >> 8), (U8)size };
+    return fwrite(type, 1, 4, file) == 4 && fwrite(len, 1, 4, file) == 4 &&
+           fwrite(data, 1, size, file) == size;
+}
+
+bool smf_write(Smf const *smf, FILE *file, Usz bpm, Usz end_tick)
+{
+    Usz tracks = 1;
+    for (Usz chan = 0; chan < 16; ++chan)
+        tracks += smf->chan_mask >> chan & 1;
+    U8 header[6] = { 0, 1, 0, (U8)tracks, 0, Smf_ticks_per_quarter };
+    if (!smf_write_chunk(file, "MThd", header, sizeof header))
+        return false;
+    if (smf->count && smf->events[smf->count - 1].tick > end_tick)
+        end_tick = smf->events[smf->count - 1].tick;
+    U32 end = (U32)end_tick * Smf_ticks_per_step;
+    // First the tempo, in microseconds per quarter note, and 4/4 time.
+    Smf_buf buf = { 0 };
+    U32 tempo = (U32)(60000000 / bpm);
+    smf_buf_put(&buf, (U8 const[]){ 0x00, 0xFF, 0x58, 0x04, 0x04, 0x02, 0x18, 0x08 }, 8);
+    U8 tempo_event[7] = { 0x00, 0xFF, 0x51, 0x03, (U8)(tempo >> 16), (U8)(tempo >> 8), (U8)tempo };
+    smf_buf_put(&buf, tempo_event, sizeof tempo_event);
+    smf_buf_put_end(&buf, end);
+    bool ok = smf_write_chunk(file, "MTrk", buf.bytes, buf.size);
+    for (Usz chan = 0; ok && chan < 16; ++chan) {
+        if (!(smf->chan_mask >> chan & 1))
+            continue;
+        buf.size = 0;
+        char name[16];
+        int name_len = snprintf(name, sizeof name, "Channel %d", (int)chan + 1);
+        smf_buf_put(&buf, (U8 const[]){ 0x00, 0xFF, 0x03, (U8)name_len }, 4);
+        smf_buf_put(&buf, (U8 const *)name, (Usz)name_len);
+        U32 last = 0;
+        for (Usz i = 0; i < smf->count; ++i) {
+            Smf_event const *e = smf->events + i;
+            if ((e->status & 0xF) != chan)
+                continue;
+            U32 time = e->tick * Smf_ticks_per_step;
+            smf_buf_put_delta(&buf, time - last);
+            last = time;
+            // Program change and channel pressure have just the one data byte
+            U8 type = e->status >> 4;
+            smf_buf_put(&buf, &e->status, 1);
+            smf_buf_put(&buf, &e->byte1, 1);
+            if (type != 0xC && type != 0xD)
+                smf_buf_put(&buf, &e->byte2, 1);
+        }
+        smf_buf_put_end(&buf, end - last);
+        ok = smf_write_chunk(file, "MTrk", buf.bytes, buf.size);
+    }
+    free(buf.bytes);
+    return ok;
+}
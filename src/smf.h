@@ -0,0 +1,40 @@
+#pragma once
+#include "base.h"
+#include <stdio.h>
+
+// Standard MIDI File (type 1) writer, for rendering a patch offline. MIDI
+// channel messages are added with the VM tick they happened on, and written
+// out with one track per channel that has any, after a first track with the
+// tempo. Ticks are 1/4 of a beat, like in playback (see player.h), and each
+// is Smf_ticks_per_step MIDI ticks, so every timestamp is exact.
+
+enum
+{
+    Smf_ticks_per_step = 24,
+    Smf_ticks_per_quarter = Smf_ticks_per_step * 4,
+    // Time between events is at most 28 bits of MIDI ticks in the file.
+    Smf_steps_max = 0x0FFFFFFF / Smf_ticks_per_step,
+};
+
+typedef struct {
+    U32 tick;
+    U8 status, byte1, byte2;
+} Smf_event;
+
+typedef struct {
+    Smf_event *events;
+    Usz count, capacity;
+    U16 chan_mask; // Channels with events
+} Smf;
+
+void smf_init(Smf *smf);
+void smf_deinit(Smf *smf);
+
+// A channel message, status being the type in the high 4 bits and the
+// channel in the low 4. tick can't be before the one of the last message, and
+// messages on the same tick stay in the order they were added.
+void smf_add(Smf *smf, Usz tick, U8 status, U8 byte1, U8 byte2);
+
+// Write the file, with the tracks lasting until end_tick. Returns false if
+// writing to file failed.
+bool smf_write(Smf const *smf, FILE *file, Usz bpm, Usz end_tick);
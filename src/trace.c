@@ -0,0 +1,231 @@
+#include "trace.h"
+
+void trace_init(Trace *t, FILE *file)
+{
+    t->file = file;
+    t->line = NULL;
+    t->line_size = 0;
+    t->line_capacity = 0;
+    t->prev = NULL;
+    t->height = 0;
+    t->width = 0;
+}
+
+void trace_deinit(Trace *t)
+{
+    free(t->line);
+    free(t->prev);
+}
+
+static void trace_reserve(Trace *t, Usz size)
+{
+    if (t->line_capacity - t->line_size >= size)
+        return;
+    Usz capacity = t->line_capacity ? t->line_capacity : 4096;
+    while (capacity - t->line_size < size)
+        capacity *= 2;
+    t->line = realloc(t->line, capacity);
+    t->line_capacity = capacity;
+}
+
+static void trace_put(Trace *t, char const *str)
+{
+    Usz len = strlen(str);
+    trace_reserve(t, len);
+    memcpy(t->line + t->line_size, str, len);
+    t->line_size += len;
+}
+
+// The writers below go straight into out, which the caller has reserved
+// enough room at, and return where they ended.
+static char *trace_write_usz(char *out, Usz value)
+{
+    char digits[24];
+    Usz n = 0;
+    do {
+        digits[sizeof digits - ++n] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    memcpy(out, digits + sizeof digits - n, n);
+    return out + n;
+}
+
+// As a JSON string, taking up to count * 2 + 2 chars.
+static char *trace_write_glyphs(char *out, Glyph const *glyphs, Usz count)
+{
+    *out++ = '"';
+    for (Usz i = 0; i < count; ++i) {
+        char c = glyphs[i];
+        if (c < '!' || c > '~')
+            c = '?';
+        else if (c == '"' || c == '\\')
+            *out++ = '\\';
+        *out++ = c;
+    }
+    *out++ = '"';
+    return out;
+}
+
+static void trace_put_usz(Trace *t, Usz value)
+{
+    trace_reserve(t, 24);
+    t->line_size = (Usz)(trace_write_usz(t->line + t->line_size, value) - t->line);
+}
+
+static void trace_put_glyphs(Trace *t, Glyph const *glyphs, Usz count)
+{
+    trace_reserve(t, count * 2 + 2);
+    t->line_size = (Usz)(trace_write_glyphs(t->line + t->line_size, glyphs, count) - t->line);
+}
+
+static void trace_end_line(Trace *t)
+{
+    trace_put(t, "\n");
+    fwrite(t->line, 1, t->line_size, t->file);
+    t->line_size = 0;
+}
+
+void trace_events(Trace *t, Usz tick, Oevent_list const *oevent_list)
+{
+    trace_put(t, "{\"tick\":");
+    trace_put_usz(t, tick);
+    trace_put(t, ",\"events\":[");
+    for (Oevent const *e = oevent_list_begin(oevent_list), *end = oevent_list_end(oevent_list);
+         e != end;
+         e = oevent_next(e)) {
+        if (e != oevent_list_begin(oevent_list))
+            trace_put(t, ",");
+        switch ((Oevent_types)e->any.oevent_type) {
+            case Oevent_type_midi_note: {
+                Oevent_midi_note const *em = &e->midi_note;
+                trace_put(t, "{\"type\":\"midi_note\",\"channel\":");
+                trace_put_usz(t, em->channel);
+                trace_put(t, ",\"octave\":");
+                trace_put_usz(t, em->octave);
+                trace_put(t, ",\"note\":");
+                trace_put_usz(t, em->note);
+                trace_put(t, ",\"velocity\":");
+                trace_put_usz(t, em->velocity);
+                trace_put(t, ",\"duration\":");
+                trace_put_usz(t, em->duration);
+                trace_put(t, em->mono ? ",\"mono\":true}" : ",\"mono\":false}");
+                break;
+            }
+            case Oevent_type_midi_cc: {
+                Oevent_midi_cc const *ec = &e->midi_cc;
+                trace_put(t, "{\"type\":\"midi_cc\",\"channel\":");
+                trace_put_usz(t, ec->channel);
+                trace_put(t, ",\"control\":");
+                trace_put_usz(t, ec->control);
+                trace_put(t, ",\"value\":");
+                trace_put_usz(t, ec->value);
+                trace_put(t, "}");
+                break;
+            }
+            case Oevent_type_midi_pb: {
+                Oevent_midi_pb const *ep = &e->midi_pb;
+                trace_put(t, "{\"type\":\"midi_pb\",\"channel\":");
+                trace_put_usz(t, ep->channel);
+                trace_put(t, ",\"lsb\":");
+                trace_put_usz(t, ep->lsb);
+                trace_put(t, ",\"msb\":");
+                trace_put_usz(t, ep->msb);
+                trace_put(t, "}");
+                break;
+            }
+            case Oevent_type_osc_ints: {
+                Oevent_osc_ints const *eo = &e->osc_ints;
+                trace_put(t, "{\"type\":\"osc\",\"glyph\":");
+                trace_put_glyphs(t, &eo->glyph, 1);
+                trace_put(t, ",\"numbers\":[");
+                for (Usz i = 0; i < eo->count; ++i) {
+                    if (i)
+                        trace_put(t, ",");
+                    trace_put_usz(t, eo->numbers[i]);
+                }
+                trace_put(t, "]}");
+                break;
+            }
+            case Oevent_type_udp_string: {
+                Oevent_udp_string const *eu = &e->udp_string;
+                trace_put(t, "{\"type\":\"udp\",\"string\":");
+                trace_put_glyphs(t, eu->chars, eu->count);
+                trace_put(t, "}");
+                break;
+            }
+        }
+    }
+    trace_put(t, "]}");
+    trace_end_line(t);
+}
+
+// The runs of cells in gbuffer that differ from prev, which then gets
+// updated to match.
+static void trace_put_cells(Trace *t, Glyph const *gbuffer)
+{
+    Usz height = t->height, width = t->width;
+    bool first = true;
+    trace_put(t, "\"cells\":[");
+    for (Usz y = 0; y < height; ++y) {
+        Glyph const *row = gbuffer + y * width;
+        Glyph *prev_row = t->prev + y * width;
+        if (!memcmp(row, prev_row, width))
+            continue;
+        for (Usz x = 0; x < width;) {
+            // Most cells don't change, so skip them 8 at a time.
+            U64 a, b;
+            if (x + 8 <= width && (memcpy(&a, row + x, 8), memcpy(&b, prev_row + x, 8), a == b)) {
+                x += 8;
+                continue;
+            }
+            if (row[x] == prev_row[x]) {
+                ++x;
+                continue;
+            }
+            Usz start = x;
+            while (x < width && row[x] != prev_row[x])
+                ++x;
+            // A lot of cells can change every tick, so this is one reserve
+            // for the whole [y,x,"glyphs"] instead of one per part.
+            trace_reserve(t, 2 * 24 + (x - start) * 2 + 8);
+            char *out = t->line + t->line_size;
+            if (!first)
+                *out++ = ',';
+            first = false;
+            *out++ = '[';
+            out = trace_write_usz(out, y);
+            *out++ = ',';
+            out = trace_write_usz(out, start);
+            *out++ = ',';
+            out = trace_write_glyphs(out, row + start, x - start);
+            *out++ = ']';
+            t->line_size = (Usz)(out - t->line);
+        }
+        memcpy(prev_row, row, width);
+    }
+    trace_put(t, "]}");
+}
+
+void trace_first_frame(Trace *t, Glyph const *gbuffer, Usz height, Usz width)
+{
+    t->height = height;
+    t->width = width;
+    t->prev = realloc(t->prev, height * width);
+    memset(t->prev, '.', height * width);
+    trace_put(t, "{\"height\":");
+    trace_put_usz(t, height);
+    trace_put(t, ",\"width\":");
+    trace_put_usz(t, width);
+    trace_put(t, ",");
+    trace_put_cells(t, gbuffer);
+    trace_end_line(t);
+}
+
+void trace_frame(Trace *t, Usz tick, Glyph const *gbuffer)
+{
+    trace_put(t, "{\"tick\":");
+    trace_put_usz(t, tick);
+    trace_put(t, ",");
+    trace_put_cells(t, gbuffer);
+    trace_end_line(t);
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "base.h"
+#include "vmio.h"
+#include <stdio.h>
+
+// Streams what a run does, a tick at a time, as JSON lines: the events each
+// tick puts out, or what changed in the grid. Only the current line and, for
+// frames, a copy of the grid are kept, so memory stays the same however long
+// the run is.
+//
+// Events, one line per tick, in the order the VM put them out:
+//
+//   {"tick":0,"events":[{"type":"midi_note","channel":0,"octave":3,"note":0,
+//     "velocity":127,"duration":4,"mono":false},{"type":"osc","glyph":"a",
+//     "numbers":[2]},{"type":"udp","string":"hi"}]}
+//
+// with "midi_cc" having "channel", "control" and "value", and "midi_pb"
+// having "channel", "lsb" and "msb".
+//
+// Frames, the grid it starts with and then one line per tick, each with the
+// runs of cells on a row that changed since the line before it as [y, x,
+// "glyphs"]. The first line is against a grid of '.':
+//
+//   {"height":25,"width":57,"cells":[[1,1,"D8"],[2,1,":03C.4"]]}
+//   {"tick":0,"cells":[[2,1,"*"]]}
+//
+// Glyphs outside '!' to '~' are written as '?', like field_fput() does.
+
+typedef struct {
+    FILE *file;
+    char *line;
+    Usz line_size, line_capacity;
+    Glyph *prev; // The grid as of the last frame
+    Usz height, width;
+} Trace;
+
+void trace_init(Trace *t, FILE *file);
+void trace_deinit(Trace *t);
+
+void trace_events(Trace *t, Usz tick, Oevent_list const *oevent_list);
+
+void trace_first_frame(Trace *t, Glyph const *gbuffer, Usz height, Usz width);
+// After trace_first_frame(), with a grid of the same size.
+void trace_frame(Trace *t, Usz tick, Glyph const *gbuffer);
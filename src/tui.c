@@ -91,6 +91,9 @@ enum
 #ifdef FEAT_PORTMIDI
     Main_menu_choose_portmidi_output,
 #endif
+#ifdef FEAT_PROFILE
+    Main_menu_profile,
+#endif
 };
 
 
@@ -174,6 +177,9 @@ void push_main_menu(void)
     qmenu_add_spacer(qm);
     qmenu_add_choice(qm, Main_menu_controls, "Controls...");
     qmenu_add_choice(qm, Main_menu_opers_guide, "Operators...");
+#ifdef FEAT_PROFILE
+    qmenu_add_choice(qm, Main_menu_profile, "Operator Profile...");
+#endif
     qmenu_add_choice(qm, Main_menu_about, "About ORCA...");
     qmenu_add_spacer(qm);
     qmenu_add_choice(qm, Main_menu_quit, "Quit");
@@ -456,6 +462,45 @@ void push_opers_guide_msg(void)
     }
 }
 
+#ifdef FEAT_PROFILE
+void push_profile_msg(void)
+{
+    enum
+    {
+        Max_rows = 20
+    };
+    Oprof const *prof = orca_profile();
+    Glyph glyphs[ORCA_ARRAY_COUNTOF(prof->glyphs)];
+    Usz count = orca_profile_sorted(prof, glyphs);
+    if (count == 0) {
+        qmsg_printf_push("Operator Profile", "No operators have run yet.");
+        return;
+    }
+    if (count > Max_rows)
+        count = Max_rows;
+    static char const header[] = "     Calls  Early exits   Time/call";
+    int total_width = 1 + 1 + (int)sizeof(header) - 1 + 1;
+    Qmsg *qm = qmsg_push((int)count + 1, total_width);
+    qmsg_set_title(qm, "Operator Profile");
+    WINDOW *w = qmsg_window(qm);
+    wmove(w, 0, 2);
+    wattrset(w, A_dim);
+    waddstr(w, header);
+    wattrset(w, A_normal);
+    for (Usz i = 0; i < count; ++i) {
+        Oprof_glyph const *pg = prof->glyphs + (U8)glyphs[i];
+        wmove(w, (int)i + 1, 1);
+        waddch(w, (chtype)glyphs[i] | A_bold);
+        wprintw(
+            w,
+            " %10llu %12llu %11.1f",
+            (unsigned long long)pg->calls,
+            (unsigned long long)pg->early_exits,
+            (double)pg->time / (double)pg->calls);
+    }
+}
+#endif
+
 void push_open_form(char const *initial)
 {
     qform_single_line_input(Open_form_id, "Open", initial);
@@ -669,7 +714,7 @@ void tui_load_conf(Tui *tui)
                 &pmerr,
                 &devid)) {
             midi_mode_deinit(&tui->ged->midi_mode);
-            pmerr = midi_mode_init_portmidi(&tui->ged->midi_mode, devid);
+            pmerr = midi_mode_init_portmidi(&tui->ged->midi_mode, devid, tui->ged->lookahead_ms);
             if (pmerr) {
                 // todo stuff
             }
@@ -811,7 +856,7 @@ bool tui_suggest_tight_grid_size(Tui *tui, int win_h, int win_w, Usz *out_grid_h
 bool tui_restart_osc_udp_if_enabled_diderror(Tui *tui)
 {
     bool error = false;
-    if (tui->osc_output_enabled && tui->osc_port) {
+    if (tui->osc_output_enabled && (tui->osc_port || tui->ged->osc_dest_count)) {
         error = !ged_set_osc_udp(tui->ged, osoc(tui->osc_address) /* null ok here */, osoc(tui->osc_port));
     } else {
         ged_clear_osc_udp(tui->ged);
@@ -960,6 +1005,11 @@ Tui_menus_result tui_drive_menus(Tui *tui, int key)
                                 case Main_menu_opers_guide:
                                     push_opers_guide_msg();
                                     break;
+#ifdef FEAT_PROFILE
+                                case Main_menu_profile:
+                                    push_profile_msg();
+                                    break;
+#endif
                                 case Main_menu_about:
                                     push_about_msg();
                                     break;
@@ -1016,12 +1066,14 @@ Tui_menus_result tui_drive_menus(Tui *tui, int key)
                                 ged_resize_grid(
                                     &tui->ged->field,
                                     &tui->ged->mbuf_r,
+                                    &tui->ged->obuf_r,
                                     new_field_h,
                                     new_field_w,
                                     tui->ged->tick_num,
                                     &tui->ged->scratch_field,
                                     &tui->ged->undo_hist,
                                     &tui->ged->ged_cursor);
+                                ged_field_replaced(tui->ged);
                                 ged_update_internal_geometry(tui->ged);
                                 tui->ged->needs_remarking = true;
                                 tui->ged->is_draw_dirty = true;
@@ -1052,6 +1104,7 @@ Tui_menus_result tui_drive_menus(Tui *tui, int key)
                                             new_field_h * new_field_w * sizeof(Glyph));
                                         ged_cursor_confine(&tui->ged->ged_cursor, new_field_h, new_field_w);
                                         markbuf_ensure_size(&tui->ged->mbuf_r, new_field_h, new_field_w);
+                                        ged_field_replaced(tui->ged);
                                         ged_update_internal_geometry(tui->ged);
                                         ged_make_cursor_visible(tui->ged);
                                         tui->ged->needs_remarking = true;
@@ -1147,7 +1200,10 @@ Tui_menus_result tui_drive_menus(Tui *tui, int key)
                         case Portmidi_output_device_menu_id: {
                             ged_stop_all_sustained_notes(tui->ged);
                             midi_mode_deinit(&tui->ged->midi_mode);
-                            PmError pme = midi_mode_init_portmidi(&tui->ged->midi_mode, act.picked.id);
+                            PmError pme = midi_mode_init_portmidi(
+                                &tui->ged->midi_mode,
+                                act.picked.id,
+                                tui->ged->lookahead_ms);
                             qnav_stack_pop();
                             if (pme) {
                                 qmsg_printf_push(
@@ -1212,6 +1268,9 @@ Tui_menus_result tui_drive_menus(Tui *tui, int key)
                                         osoc(temp_name),
                                         field_load_error_string(fle));
                                 }
+                                // After the pop, so a file that failed to load
+                                // partway doesn't reach the ticker.
+                                ged_field_replaced(tui->ged);
                                 osofree(temp_name);
                                 break;
                             }
@@ -1279,12 +1338,14 @@ Tui_menus_result tui_drive_menus(Tui *tui, int key)
                                         ged_resize_grid(
                                             &tui->ged->field,
                                             &tui->ged->mbuf_r,
+                                            &tui->ged->obuf_r,
                                             (Usz)newheight,
                                             (Usz)newwidth,
                                             tui->ged->tick_num,
                                             &tui->ged->scratch_field,
                                             &tui->ged->undo_hist,
                                             &tui->ged->ged_cursor);
+                                        ged_field_replaced(tui->ged);
                                         ged_update_internal_geometry(tui->ged);
                                         tui->ged->needs_remarking = true;
                                         tui->ged->is_draw_dirty = true;
@@ -31,6 +31,10 @@ void push_controls_msg(void);
 
 void push_opers_guide_msg(void);
 
+#ifdef FEAT_PROFILE
+void push_profile_msg(void);
+#endif
+
 void push_open_form(char const *initial);
 
 void tui_load_conf(Tui *tui);
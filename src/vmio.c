@@ -1,10 +1,16 @@
 #include "vmio.h"
 
+enum
+{
+    Oevent_list_initial_capacity = 4096 // In bytes
+};
+
 void oevent_list_init(Oevent_list *olist)
 {
-    olist->buffer = NULL;
+    olist->buffer = malloc(Oevent_list_initial_capacity);
+    olist->size = 0;
+    olist->capacity = Oevent_list_initial_capacity;
     olist->count = 0;
-    olist->capacity = 0;
 }
 void oevent_list_deinit(Oevent_list *olist)
 {
@@ -12,31 +18,28 @@ void oevent_list_deinit(Oevent_list *olist)
 }
 void oevent_list_clear(Oevent_list *olist)
 {
+    olist->size = 0;
     olist->count = 0;
 }
 void oevent_list_copy(Oevent_list const *src, Oevent_list *dest)
 {
-    Usz src_count = src->count;
-    if (dest->capacity < src_count) {
-        Usz new_cap = orca_round_up_power2(src_count);
-        dest->buffer = realloc(dest->buffer, new_cap * sizeof(Oevent));
-        dest->capacity = new_cap;
-    }
-    memcpy(dest->buffer, src->buffer, src_count * sizeof(Oevent));
-    dest->count = src_count;
+    oevent_list_clear(dest);
+    oevent_list_append(dest, src);
+}
+void oevent_list_append(Oevent_list *dest, Oevent_list const *src)
+{
+    if (dest->capacity - dest->size < src->size)
+        oevent_list_grow(dest, src->size);
+    memcpy(dest->buffer + dest->size, src->buffer, src->size);
+    dest->size += src->size;
+    dest->count += src->count;
 }
-Oevent *oevent_list_alloc_item(Oevent_list *olist)
+void oevent_list_grow(Oevent_list *olist, Usz size)
 {
-    Usz count = olist->count;
-    if (olist->capacity == count) {
-        // Note: no overflow check, but you're probably out of memory if this
-        // happens anyway. Like other uses of realloc in orca, we also don't check
-        // for a failed allocation.
-        Usz capacity = count < 16 ? 16 : orca_round_up_power2(count + 1);
-        olist->buffer = realloc(olist->buffer, capacity * sizeof(Oevent));
-        olist->capacity = capacity;
-    }
-    Oevent *result = olist->buffer + count;
-    olist->count = count + 1;
-    return result;
+    // Note: no overflow check, but you're probably out of memory if this
+    // happens anyway. Like other uses of realloc in orca, we also don't check
+    // for a failed allocation.
+    Usz capacity = orca_round_up_power2(olist->size + size);
+    olist->buffer = realloc(olist->buffer, capacity);
+    olist->capacity = capacity;
 }
@@ -16,12 +16,20 @@ typedef enum
     Oevent_type_udp_string,
 } Oevent_types;
 
+// Events are stored back to back in a byte buffer, each one as a type tag
+// and its size in bytes (header included), followed by its own fields. So a
+// MIDI note takes 7 bytes, and OSC and UDP events only take up as many
+// numbers or chars as they have. Everything is a byte, so records need no
+// alignment.
+
 typedef struct {
     U8 oevent_type;
+    U8 size;
 } Oevent_any;
 
 typedef struct {
     U8 oevent_type;
+    U8 size;
     U8 channel;
     U8 octave;
     U8 note;
@@ -32,6 +40,7 @@ typedef struct {
 
 typedef struct {
     U8 oevent_type;
+    U8 size;
     U8 channel;
     U8 control;
     U8 value;
@@ -39,6 +48,7 @@ typedef struct {
 
 typedef struct {
     U8 oevent_type;
+    U8 size;
     U8 channel;
     U8 lsb;
     U8 msb;
@@ -46,15 +56,17 @@ typedef struct {
 
 typedef struct {
     U8 oevent_type;
+    U8 size;
     Glyph glyph;
     U8 count;
-    U8 numbers[Oevent_osc_int_count];
+    U8 numbers[]; // count of them, up to Oevent_osc_int_count
 } Oevent_osc_ints;
 
 typedef struct {
     U8 oevent_type;
+    U8 size;
     U8 count;
-    char chars[Oevent_udp_string_count];
+    char chars[]; // count of them, up to Oevent_udp_string_count
 } Oevent_udp_string;
 
 typedef union {
@@ -67,8 +79,9 @@ typedef union {
 } Oevent;
 
 typedef struct {
-    Oevent *buffer;
-    Usz count, capacity;
+    U8 *buffer;
+    Usz size, capacity; // In bytes
+    Usz count; // Of events
 } Oevent_list;
 
 void oevent_list_init(Oevent_list *olist);
@@ -77,4 +90,38 @@ void oevent_list_clear(Oevent_list *olist);
 ORCA_NOINLINE
 void oevent_list_copy(Oevent_list const *src, Oevent_list *dest);
 ORCA_NOINLINE
-Oevent *oevent_list_alloc_item(Oevent_list *olist);
+void oevent_list_append(Oevent_list *dest, Oevent_list const *src);
+ORCA_NOINLINE
+void oevent_list_grow(Oevent_list *olist, Usz size);
+
+// Adds an event of the given type and size in bytes, with its header filled
+// in. The buffer is allocated up front and kept between ticks, so this only
+// calls the allocator when a tick emits more than any tick before it.
+static ORCA_FORCEINLINE Oevent *
+oevent_list_alloc_item(Oevent_list *olist, Oevent_types type, Usz size)
+{
+    if (ORCA_UNLIKELY(olist->capacity - olist->size < size))
+        oevent_list_grow(olist, size);
+    Oevent *result = (Oevent *)(olist->buffer + olist->size);
+    olist->size += size;
+    ++olist->count;
+    result->any.oevent_type = (U8)type;
+    result->any.size = (U8)size;
+    return result;
+}
+
+// Walking the events:
+//   for (Oevent const *e = oevent_list_begin(l), *end = oevent_list_end(l);
+//        e != end; e = oevent_next(e))
+static inline Oevent const *oevent_list_begin(Oevent_list const *olist)
+{
+    return (Oevent const *)olist->buffer;
+}
+static inline Oevent const *oevent_list_end(Oevent_list const *olist)
+{
+    return (Oevent const *)(olist->buffer + olist->size);
+}
+static inline Oevent const *oevent_next(Oevent const *e)
+{
+    return (Oevent const *)((U8 const *)e + e->any.size);
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <stdarg.h>
+#include <stdio.h>
+
+// What the tests that check their own results share: they count failed
+// checks, and end with a line saying how it went and an exit status to
+// match. Each says what a failure was about after check_failed().
+
+static int check_failures;
+
+static inline void check_failed(char const *fmt, ...)
+{
+    ++check_failures;
+    va_list ap;
+    va_start(ap, fmt);
+    printf("FAIL ");
+    vprintf(fmt, ap);
+    printf("\n");
+    va_end(ap);
+}
+
+// For the end of main().
+static inline int check_done(void)
+{
+    printf(check_failures ? "%d FAILED\n" : "All passed\n", check_failures);
+    return check_failures ? 1 : 0;
+}
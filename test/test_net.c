@@ -0,0 +1,160 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../src/net.h"
+#include "../src/vmio.h"
+#include "check.h"
+
+// Shared memory publishing: a reader that maps the segment read-only, the way
+// net.h says to, sees whole ticks, including while they're being written and
+// after the segment grows.
+
+typedef struct {
+    int fd;
+    U8 const *map;
+    Usz mapped_size;
+} Reader;
+
+// One tick, as it was between two matching reads of seq.
+typedef struct {
+    U64 tick_num, height, width, event_count;
+    Glyph glyphs[256 * 256];
+    Mark marks[256 * 256];
+    U8 events[256];
+    Usz events_size;
+} Frame;
+
+static void reader_map(Reader *r)
+{
+    if (r->map)
+        munmap((void *)r->map, r->mapped_size);
+    struct stat st;
+    fstat(r->fd, &st);
+    r->mapped_size = (Usz)st.st_size;
+    r->map = mmap(NULL, r->mapped_size, PROT_READ, MAP_SHARED, r->fd, 0);
+}
+
+static void reader_read(Reader *r, Frame *f)
+{
+    Net_shm_header const *h = (Net_shm_header const *)r->map;
+    for (;;) {
+        U64 seq = __atomic_load_n(&h->seq, __ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&h->size, __ATOMIC_ACQUIRE) > r->mapped_size) {
+            reader_map(r);
+            h = (Net_shm_header const *)r->map;
+            continue;
+        }
+        if (seq & 1)
+            continue;
+        f->tick_num = h->tick_num;
+        f->height = h->height;
+        f->width = h->width;
+        f->event_count = h->event_count;
+        U64 cells = f->height * f->width, events_size = h->events_size;
+        U64 glyphs_at = h->glyphs_at, marks_at = h->marks_at, events_at = h->events_at;
+        if (cells <= sizeof f->glyphs && glyphs_at + cells <= r->mapped_size &&
+            marks_at + cells <= r->mapped_size && events_size <= sizeof f->events &&
+            events_at + events_size <= r->mapped_size) {
+            memcpy(f->glyphs, r->map + glyphs_at, cells);
+            memcpy(f->marks, r->map + marks_at, cells);
+            memcpy(f->events, r->map + events_at, events_size);
+            f->events_size = events_size;
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&h->seq, __ATOMIC_RELAXED) == seq)
+            return;
+    }
+}
+
+// Ticks where every glyph and mark says which tick it is, and the grid gets
+// bigger as it goes.
+static void publish_tick(Net_shm *shm, Usz tick, Usz size)
+{
+    static Glyph glyphs[256 * 256];
+    static Mark marks[256 * 256];
+    memset(glyphs, 'a' + (int)(tick % 26), size * size);
+    memset(marks, (int)(tick & 0xFF), size * size);
+    U8 events[3] = { Oevent_type_midi_cc, 5, (U8)tick };
+    Usz count = tick % 4 ? 1 : 0;
+    net_shm_publish(shm, glyphs, marks, size, size, tick, events, count * sizeof events, count);
+}
+
+static bool frame_is_whole(Frame const *f)
+{
+    U64 cells = f->height * f->width;
+    for (U64 i = 0; i < cells; ++i) {
+        if (f->glyphs[i] != 'a' + (int)(f->tick_num % 26) || f->marks[i] != (Mark)f->tick_num)
+            return false;
+    }
+    if (f->tick_num % 4 == 0)
+        return f->events_size == 0 && f->event_count == 0;
+    return f->events_size == 3 && f->event_count == 1 && f->events[2] == (U8)f->tick_num;
+}
+
+enum { Writer_ticks = 20000 };
+
+static void *writer_run(void *shm)
+{
+    for (Usz tick = 1; tick < Writer_ticks; ++tick)
+        publish_tick(shm, tick, 16 + tick * 240 / Writer_ticks);
+    return NULL;
+}
+
+int main(void)
+{
+    char name[64];
+    snprintf(name, sizeof name, "/orca_test_net_%d", (int)getpid());
+    Net_shm *shm = net_shm_create(name);
+    if (!shm) {
+        check_failed("couldn't create %s: %s", name, strerror(errno));
+        return check_done();
+    }
+    Reader r = { shm_open(name, O_RDONLY, 0), NULL, 0 };
+    reader_map(&r);
+    Net_shm_header const *h = (Net_shm_header const *)r.map;
+    if (h->magic != Net_shm_magic || h->version != Net_shm_version || h->seq != 0)
+        check_failed("header before the first tick");
+
+    Frame *f = malloc(sizeof(Frame));
+    Glyph glyphs[6] = { 'D', '8', '.', '.', '*', 'a' };
+    Mark marks[6] = { 1, 2, 0, 0, 3, 4 };
+    U8 events[7] = { Oevent_type_midi_note, 7, 1, 3, 2, 100, 4 };
+    net_shm_publish(shm, glyphs, marks, 2, 3, 7, events, sizeof events, 1);
+    reader_read(&r, f);
+    if (f->tick_num != 7 || f->height != 2 || f->width != 3 || f->event_count != 1 ||
+        memcmp(f->glyphs, glyphs, 6) || memcmp(f->marks, marks, 6) ||
+        f->events_size != sizeof events || memcmp(f->events, events, sizeof events))
+        check_failed("first tick");
+
+    // Growing from 16x16 to 255x255 while being read
+    publish_tick(shm, 0, 16);
+    pthread_t writer;
+    pthread_create(&writer, NULL, writer_run, shm);
+    Usz reads = 0, torn = 0;
+    do {
+        reader_read(&r, f);
+        ++reads;
+        torn += !frame_is_whole(f);
+    } while (f->tick_num != Writer_ticks - 1);
+    pthread_join(writer, NULL);
+    if (torn) {
+        check_failed("reading while it's written");
+        printf("  %zu of %zu reads weren't one whole tick\n", torn, reads);
+    }
+    if (r.mapped_size < sizeof(Net_shm_header) + 2 * 255 * 255)
+        check_failed("growing");
+
+    net_shm_destroy(shm);
+    if (shm_open(name, O_RDONLY, 0) >= 0 || errno != ENOENT)
+        check_failed("unlinking");
+    munmap((void *)r.map, r.mapped_size);
+    close(r.fd);
+    free(f);
+    return check_done();
+}
@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/output.h"
+#include "check.h"
+
+// ORCA output stage: what output_events() sends for a tick's events, and when
+// the sustained notes it starts end.
+
+typedef struct {
+    char lines[4096][32];
+    Usz count;
+} Sent;
+
+static void sent_add(Sent *s, char const *line)
+{
+    if (s->count < ORCA_ARRAY_COUNTOF(s->lines))
+        snprintf(s->lines[s->count], sizeof s->lines[0], "%s", line);
+    ++s->count;
+}
+
+static void sent_midi(void *userdata, U8 status, U8 byte1, U8 byte2)
+{
+    char line[32];
+    char const *type = status >> 4 == 0x9 ? "on" : status >> 4 == 0x8 ? "off" : "msg";
+    if (status >> 4 == 0x9 || status >> 4 == 0x8)
+        snprintf(line, sizeof line, "%s %d %d", type, status & 0xF, byte1);
+    else
+        snprintf(line, sizeof line, "%s %02x %d %d", type, status, byte1, byte2);
+    sent_add(userdata, line);
+}
+
+static void sent_osc_ints(void *userdata, char const *osc_address, I32 const *vals, Usz count)
+{
+    char line[32];
+    snprintf(line, sizeof line, "osc %s %zu %d", osc_address, count, count ? vals[0] : -1);
+    sent_add(userdata, line);
+}
+
+static void sent_datagram(void *userdata, char const *data, Usz size)
+{
+    char line[32];
+    snprintf(line, sizeof line, "udp %.*s", (int)size, data);
+    sent_add(userdata, line);
+}
+
+// The lines sent since the last check must be exactly expected, which ends
+// with NULL.
+static void check(char const *what, Sent *s, char const *const *expected)
+{
+    Usz n = 0;
+    while (expected[n])
+        ++n;
+    bool ok = s->count == n;
+    for (Usz i = 0; ok && i < n; ++i)
+        ok = strcmp(s->lines[i], expected[i]) == 0;
+    if (!ok) {
+        check_failed("%s", what);
+        printf("  sent:");
+        for (Usz i = 0; i < s->count && i < ORCA_ARRAY_COUNTOF(s->lines); ++i)
+            printf(" [%s]", s->lines[i]);
+        printf("\n  expected:");
+        for (Usz i = 0; i < n; ++i)
+            printf(" [%s]", expected[i]);
+        printf("\n");
+    }
+    s->count = 0;
+}
+
+static void add_note(Oevent_list *ol, U8 channel, U8 number, U8 duration, bool mono)
+{
+    Oevent_midi_note *oe =
+        &oevent_list_alloc_item(ol, Oevent_type_midi_note, sizeof(Oevent_midi_note))->midi_note;
+    oe->channel = channel;
+    oe->octave = number / 12;
+    oe->note = number % 12;
+    oe->velocity = 100;
+    oe->duration = (U8)(duration & 0x7F);
+    oe->mono = mono;
+}
+
+static void add_cc(Oevent_list *ol, U8 channel, U8 control, U8 value)
+{
+    Oevent_midi_cc *oe =
+        &oevent_list_alloc_item(ol, Oevent_type_midi_cc, sizeof(Oevent_midi_cc))->midi_cc;
+    oe->channel = channel;
+    oe->control = control;
+    oe->value = value;
+}
+
+static void add_osc(Oevent_list *ol, Glyph glyph, U8 number)
+{
+    Oevent_osc_ints *oe =
+        &oevent_list_alloc_item(ol, Oevent_type_osc_ints, sizeof(Oevent_osc_ints) + 1)->osc_ints;
+    oe->glyph = glyph;
+    oe->count = 1;
+    oe->numbers[0] = number;
+}
+
+static void add_udp(Oevent_list *ol, char const *str)
+{
+    Usz count = strlen(str);
+    Oevent_udp_string *oe =
+        &oevent_list_alloc_item(ol, Oevent_type_udp_string, sizeof(Oevent_udp_string) + count)
+             ->udp_string;
+    oe->count = (U8)count;
+    memcpy(oe->chars, str, count);
+}
+
+// A tick passes for the sustained notes, like play_clock_step() does before
+// the VM runs, and the notes it ends are sent.
+static void advance(Susnote_table *st, Output_sink const *sink)
+{
+    Usz offs = susnote_table_advance(st);
+    for (Usz i = 0; i < offs; ++i)
+        sink->midi(sink->userdata, (U8)(0x80 | st->offs[i] >> 7), (U8)(st->offs[i] & 0x7F), 0);
+}
+
+int main(void)
+{
+    static Sent sent;
+    static Susnote_table st;
+    Output_sink sink = {
+        .midi = sent_midi,
+        .osc_ints = sent_osc_ints,
+        .datagram = sent_datagram,
+        .userdata = &sent,
+    };
+    Oevent_list ol;
+    oevent_list_init(&ol);
+
+    // Polyphonic notes end after their own durations
+    {
+        susnote_table_init(&st);
+        oevent_list_clear(&ol);
+        add_note(&ol, 0, 60, 2, false);
+        add_note(&ol, 0, 64, 1, false);
+        add_note(&ol, 1, 60, 3, false);
+        output_events(&sink, &st, &ol);
+        check("poly on", &sent, (char const *[]){ "on 0 60", "on 0 64", "on 1 60", NULL });
+        advance(&st, &sink);
+        check("poly tick 1", &sent, (char const *[]){ "off 0 64", NULL });
+        advance(&st, &sink);
+        check("poly tick 2", &sent, (char const *[]){ "off 0 60", NULL });
+        advance(&st, &sink);
+        check("poly tick 3", &sent, (char const *[]){ "off 1 60", NULL });
+        advance(&st, &sink);
+        check("poly tick 4", &sent, (char const *[]){ NULL });
+    }
+
+    // A duration of 0 lasts 1 tick, and long ones cross the runs of the wheel
+    {
+        susnote_table_init(&st);
+        oevent_list_clear(&ol);
+        add_note(&ol, 2, 10, 0, false);
+        add_note(&ol, 2, 11, 100, false);
+        output_events(&sink, &st, &ol);
+        check("durations on", &sent, (char const *[]){ "on 2 10", "on 2 11", NULL });
+        advance(&st, &sink);
+        check("duration 0", &sent, (char const *[]){ "off 2 10", NULL });
+        for (int i = 1; i < 99; ++i)
+            advance(&st, &sink);
+        check("duration 100 early", &sent, (char const *[]){ NULL });
+        advance(&st, &sink);
+        check("duration 100", &sent, (char const *[]){ "off 2 11", NULL });
+    }
+
+    // A note that's on is ended right before it's played again, and keeps
+    // only its new duration
+    {
+        susnote_table_init(&st);
+        oevent_list_clear(&ol);
+        add_note(&ol, 0, 60, 5, false);
+        add_note(&ol, 0, 60, 1, false);
+        output_events(&sink, &st, &ol);
+        check("retrigger", &sent, (char const *[]){ "on 0 60", "off 0 60", "on 0 60", NULL });
+        advance(&st, &sink);
+        check("retrigger end", &sent, (char const *[]){ "off 0 60", NULL });
+        for (int i = 0; i < 8; ++i)
+            advance(&st, &sink);
+        check("retrigger no second end", &sent, (char const *[]){ NULL });
+    }
+
+    // Everything goes out in the order the VM put it out
+    {
+        susnote_table_init(&st);
+        oevent_list_clear(&ol);
+        add_cc(&ol, 3, 7, 127);
+        add_note(&ol, 3, 48, 1, false);
+        add_osc(&ol, 'a', 9);
+        add_udp(&ol, "hello");
+        add_cc(&ol, 3, 7, 0);
+        output_events(&sink, &st, &ol);
+        check(
+            "order",
+            &sent,
+            (char const *[]){
+                "msg b3 7 127", "on 3 48", "osc /a 1 9", "udp hello", "msg b3 7 0", NULL });
+    }
+
+    // Mono notes end what's on on their channel, from earlier ticks and from
+    // earlier in the same one, and nothing on other channels
+    {
+        susnote_table_init(&st);
+        oevent_list_clear(&ol);
+        add_note(&ol, 4, 60, 8, false);
+        add_note(&ol, 5, 60, 8, false);
+        output_events(&sink, &st, &ol);
+        check("mono setup", &sent, (char const *[]){ "on 4 60", "on 5 60", NULL });
+        advance(&st, &sink);
+        oevent_list_clear(&ol);
+        add_note(&ol, 4, 62, 8, false);
+        add_note(&ol, 4, 70, 2, true);
+        add_note(&ol, 4, 72, 2, true);
+        output_events(&sink, &st, &ol);
+        check(
+            "mono",
+            &sent,
+            (char const *[]){
+                "on 4 62", "off 4 60", "off 4 62", "on 4 70", "off 4 70", "on 4 72", NULL });
+        advance(&st, &sink);
+        check("mono tick 1", &sent, (char const *[]){ NULL });
+        advance(&st, &sink);
+        check("mono tick 2", &sent, (char const *[]){ "off 4 72", NULL });
+        // A mono note on a channel with nothing on only starts
+        oevent_list_clear(&ol);
+        add_note(&ol, 6, 30, 1, true);
+        output_events(&sink, &st, &ol);
+        check("mono alone", &sent, (char const *[]){ "on 6 30", NULL });
+        advance(&st, &sink);
+        check("mono alone end", &sent, (char const *[]){ "off 6 30", NULL });
+        for (int i = 0; i < 4; ++i)
+            advance(&st, &sink);
+        check("other channel untouched", &sent, (char const *[]){ "off 5 60", NULL });
+    }
+
+    // No limit on how many notes a tick can start
+    {
+        susnote_table_init(&st);
+        oevent_list_clear(&ol);
+        for (Usz i = 0; i < 2048; ++i)
+            add_note(&ol, (U8)(i / 128), (U8)(i % 128), 1, false);
+        output_events(&sink, &st, &ol);
+        Usz ons = sent.count;
+        sent.count = 0;
+        advance(&st, &sink);
+        Usz offs = sent.count;
+        sent.count = 0;
+        if (ons != 2048 || offs != 2048) {
+            check_failed("many notes: %zu on, %zu off", ons, offs);
+        }
+    }
+
+    oevent_list_deinit(&ol);
+    return check_done();
+}
@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/smf.h"
+#include "check.h"
+
+// Standard MIDI File writer: the bytes smf_write() puts out for a few
+// messages on two channels.
+
+static void check(char const *what, U8 const *got, Usz got_size, U8 const *expected, Usz size)
+{
+    if (got_size == size && memcmp(got, expected, size) == 0)
+        return;
+    check_failed("%s", what);
+    printf("  wrote:   ");
+    for (Usz i = 0; i < got_size; ++i)
+        printf(" %02x", got[i]);
+    printf("\n  expected:");
+    for (Usz i = 0; i < size; ++i)
+        printf(" %02x", expected[i]);
+    printf("\n");
+}
+
+int main(void)
+{
+    Smf smf;
+    smf_init(&smf);
+    smf_add(&smf, 0, 0x90, 60, 100);
+    smf_add(&smf, 0, 0x93, 40, 90);
+    smf_add(&smf, 1, 0x80, 60, 0);
+    smf_add(&smf, 1, 0xB3, 7, 127);
+    // 6 ticks is 144 MIDI ticks, which takes 2 bytes
+    smf_add(&smf, 7, 0x83, 40, 0);
+    FILE *file = tmpfile();
+    if (!file || !smf_write(&smf, file, 150, 8)) {
+        check_failed("couldn't write");
+        return check_done();
+    }
+    smf_deinit(&smf);
+    U8 got[256];
+    rewind(file);
+    Usz got_size = fread(got, 1, sizeof got, file);
+    fclose(file);
+
+    // clang-format off
+    static U8 const expected[] = {
+        // Type 1, 3 tracks, 96 ticks per quarter note
+        'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1, 0, 3, 0, 96,
+        // 4/4, 400000 us per quarter note, ending at tick 8
+        'M', 'T', 'r', 'k', 0, 0, 0, 20,
+        0x00, 0xFF, 0x58, 0x04, 0x04, 0x02, 0x18, 0x08,
+        0x00, 0xFF, 0x51, 0x03, 0x06, 0x1A, 0x80,
+        0x81, 0x40, 0xFF, 0x2F, 0x00,
+        'M', 'T', 'r', 'k', 0, 0, 0, 26,
+        0x00, 0xFF, 0x03, 9, 'C', 'h', 'a', 'n', 'n', 'e', 'l', ' ', '1',
+        0x00, 0x90, 60, 100,
+        0x18, 0x80, 60, 0,
+        0x81, 0x28, 0xFF, 0x2F, 0x00,
+        'M', 'T', 'r', 'k', 0, 0, 0, 30,
+        0x00, 0xFF, 0x03, 9, 'C', 'h', 'a', 'n', 'n', 'e', 'l', ' ', '4',
+        0x00, 0x93, 40, 90,
+        0x18, 0xB3, 7, 127,
+        0x81, 0x10, 0x83, 40, 0,
+        0x18, 0xFF, 0x2F, 0x00,
+    };
+    // clang-format on
+    check("file", got, got_size, expected, sizeof expected);
+
+    return check_done();
+}
@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/trace.h"
+#include "check.h"
+
+// Streaming traces: the JSON lines trace_events() and the frame functions
+// write.
+
+// What was written to file since the last check, which starts reading at
+// *pos, must be exactly expected.
+static void check(char const *what, FILE *file, long *pos, char const *expected)
+{
+    char got[1024];
+    fseek(file, *pos, SEEK_SET);
+    Usz size = fread(got, 1, sizeof got - 1, file);
+    got[size] = '\0';
+    *pos = ftell(file);
+    if (strcmp(got, expected) != 0) {
+        check_failed("%s", what);
+        printf("  wrote:    %s  expected: %s", got, expected);
+    }
+}
+
+int main(void)
+{
+    Oevent_list ol;
+    oevent_list_init(&ol);
+    Oevent_midi_note *note =
+        &oevent_list_alloc_item(&ol, Oevent_type_midi_note, sizeof(Oevent_midi_note))->midi_note;
+    note->channel = 1;
+    note->octave = 3;
+    note->note = 2;
+    note->velocity = 100;
+    note->duration = 4;
+    note->mono = 1;
+    Oevent_osc_ints *osc =
+        &oevent_list_alloc_item(&ol, Oevent_type_osc_ints, sizeof(Oevent_osc_ints) + 2)->osc_ints;
+    osc->glyph = 'a';
+    osc->count = 2;
+    osc->numbers[0] = 0;
+    osc->numbers[1] = 35;
+    Oevent_udp_string *udp =
+        &oevent_list_alloc_item(&ol, Oevent_type_udp_string, sizeof(Oevent_udp_string) + 3)
+             ->udp_string;
+    udp->count = 3;
+    memcpy(udp->chars, "a\"\\", 3);
+
+    Trace t;
+    long pos = 0;
+    FILE *file = tmpfile();
+    trace_init(&t, file);
+    trace_events(&t, 1234, &ol);
+    check(
+        "events",
+        file,
+        &pos,
+        "{\"tick\":1234,\"events\":[{\"type\":\"midi_note\",\"channel\":1,\"octave\":3,"
+        "\"note\":2,\"velocity\":100,\"duration\":4,\"mono\":true},{\"type\":\"osc\","
+        "\"glyph\":\"a\",\"numbers\":[0,35]},{\"type\":\"udp\",\"string\":\"a\\\"\\\\\"}]}\n");
+    oevent_list_clear(&ol);
+    trace_events(&t, 0, &ol);
+    check("no events", file, &pos, "{\"tick\":0,\"events\":[]}\n");
+    trace_deinit(&t);
+    fclose(file);
+
+    // Rows of 11, so runs cross the 8 cells skipped at a time
+    Glyph grid[2 * 11];
+    memcpy(grid, "D8.......ab..:03C.4.*", 2 * 11);
+    grid[21] = '\n';
+    pos = 0;
+    file = tmpfile();
+    trace_init(&t, file);
+    trace_first_frame(&t, grid, 2, 11);
+    check(
+        "first frame",
+        file,
+        &pos,
+        "{\"height\":2,\"width\":11,\"cells\":[[0,0,\"D8\"],[0,9,\"ab\"],[1,2,\":03C\"],"
+        "[1,7,\"4\"],[1,9,\"*?\"]]}\n");
+    trace_frame(&t, 0, grid);
+    check("same frame", file, &pos, "{\"tick\":0,\"cells\":[]}\n");
+    grid[1] = '7';
+    grid[8] = 'x';
+    grid[9] = 'y';
+    grid[21] = '.';
+    trace_frame(&t, 1, grid);
+    check(
+        "changes", file, &pos, "{\"tick\":1,\"cells\":[[0,1,\"7\"],[0,8,\"xy\"],[1,10,\".\"]]}\n");
+    trace_deinit(&t);
+    fclose(file);
+
+    oevent_list_deinit(&ol);
+    return check_done();
+}